@@ -0,0 +1,77 @@
+# Profile guided optimisation workflow, run by the pgo target:
+#   cmake -DSOURCE_DIR=<src> -DBINARY_DIR=<build> -DCXX_COMPILER=<c++> -DCXX_COMPILER_ID=<id> -P pgo.cmake
+#
+# 1. configures and builds an instrumented sm3tools in BINARY_DIR
+# 2. generates a PCSSB corpus with gencorpus and runs the common modes over it
+#    (list, raw + wav extraction, replace, catalog, find)
+# 3. rebuilds sm3tools in the same directory using the recorded profile
+#    (GCC looks its profile files up by object path, so the directory must not change)
+
+cmake_minimum_required(VERSION 3.15)
+
+foreach(variable SOURCE_DIR BINARY_DIR CXX_COMPILER CXX_COMPILER_ID)
+  if(NOT DEFINED ${variable})
+    message(FATAL_ERROR "pgo.cmake: ${variable} is not set")
+  endif()
+endforeach()
+
+set(PROFILE_DIR "${BINARY_DIR}/profile")
+set(CORPUS_DIR "${BINARY_DIR}/corpus")
+set(TRAINING_DIR "${BINARY_DIR}/training")
+set(SM3TOOLS "${BINARY_DIR}/bin/sm3tools")
+
+function(run)
+  execute_process(COMMAND ${ARGN} RESULT_VARIABLE result OUTPUT_QUIET)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "pgo.cmake: '${ARGN}' failed (${result})")
+  endif()
+endfunction()
+
+function(build_stage stage)
+  message(STATUS "PGO: building with SM3TOOLS_PGO=${stage}")
+  run(${CMAKE_COMMAND} -S ${SOURCE_DIR} -B ${BINARY_DIR}
+    -DCMAKE_BUILD_TYPE=Release
+    -DCMAKE_CXX_COMPILER=${CXX_COMPILER}
+    -DSM3TOOLS_PGO=${stage}
+    -DSM3TOOLS_PGO_DIR=${PROFILE_DIR})
+  run(${CMAKE_COMMAND} --build ${BINARY_DIR} --target ${ARGN} --clean-first)
+endfunction()
+
+file(REMOVE_RECURSE "${PROFILE_DIR}" "${CORPUS_DIR}" "${TRAINING_DIR}")
+
+build_stage(GENERATE sm3tools gencorpus)
+
+message(STATUS "PGO: training on a generated corpus")
+run("${BINARY_DIR}/bin/gencorpus" "${CORPUS_DIR}")
+file(GLOB archives "${CORPUS_DIR}/*.pcssb")
+foreach(archive ${archives})
+  get_filename_component(stem "${archive}" NAME_WE)
+  run("${SM3TOOLS}" -i "${archive}" -l)
+  run("${SM3TOOLS}" -i "${archive}" -o "${TRAINING_DIR}/raw/${stem}")
+  run("${SM3TOOLS}" -i "${archive}" -o "${TRAINING_DIR}/wav/${stem}" -f wav)
+endforeach()
+file(GLOB replacements "${CORPUS_DIR}/replace/*")
+list(GET archives 0 firstArchive)
+foreach(replacement ${replacements})
+  run("${SM3TOOLS}" -i "${firstArchive}" -r "${replacement}" -o "${TRAINING_DIR}/replace")
+endforeach()
+run("${SM3TOOLS}" -bc "${CORPUS_DIR}" -c "${TRAINING_DIR}/sm3tools.catalog")
+run("${SM3TOOLS}" -lu sample_03_002.wav -c "${TRAINING_DIR}/sm3tools.catalog")
+file(GLOB_RECURSE extracted "${TRAINING_DIR}/wav/*")
+list(GET extracted 0 firstExtracted)
+run("${SM3TOOLS}" -wh "${firstExtracted}" -c "${TRAINING_DIR}/sm3tools.catalog")
+run("${SM3TOOLS}" -fd "sample_*_01?.wav" -d "${CORPUS_DIR}")
+
+if(CXX_COMPILER_ID MATCHES "Clang")
+  get_filename_component(compilerDir "${CXX_COMPILER}" DIRECTORY)
+  find_program(LLVM_PROFDATA NAMES llvm-profdata HINTS "${compilerDir}")
+  if(NOT LLVM_PROFDATA)
+    message(FATAL_ERROR "pgo.cmake: llvm-profdata is needed to merge Clang profiles")
+  endif()
+  file(GLOB rawProfiles "${PROFILE_DIR}/*.profraw")
+  run("${LLVM_PROFDATA}" merge -output=${PROFILE_DIR}/sm3tools.profdata ${rawProfiles})
+endif()
+
+build_stage(USE sm3tools)
+file(REMOVE_RECURSE "${TRAINING_DIR}")
+message(STATUS "PGO: optimised binary is ${SM3TOOLS}")
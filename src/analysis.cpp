@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "analysis.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cmath>
+#include <filesystem>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SM3TOOLS_SSE2 1
+#endif
+
+#include "myIO.hpp"
+#include "bytes.hpp"
+#include "wav.hpp"
+
+//16 bit samples at or beyond these count as clipped
+constexpr std::int32_t CLIP_LEVEL_16 { 32767 };
+//8 bit samples are scaled up to 16 bits before being analysed
+constexpr std::int32_t CLIP_LEVEL_8 { 127 * 256 };
+
+//number of 8 bit samples scaled up at once
+constexpr std::size_t WIDEN_BUFFER_SAMPLES { 4096 };
+
+//level reported in dBFS for silence, instead of negative infinity
+constexpr double SILENT_DBFS { -144.0 };
+
+//marks the sample at index (counted from the start of the FSB) as being above the silence threshold
+static void markLoudSample(AudioAnalyser& analyser, const std::uint64_t index) {
+    if (!analyser.foundLoudSample) {
+        analyser.foundLoudSample = true;
+        analyser.firstLoudSample = index;
+    }
+    analyser.lastLoudSample = index;
+}
+
+//adds count little-endian signed 16 bit samples to the totals
+static void analyseSamples16(
+    AudioAnalyser& analyser,
+    const unsigned char *const samples,
+    const std::size_t count,
+    const std::int32_t clipLevel) {
+
+    const std::uint64_t firstIndex { analyser.sampleCount };
+    std::size_t i { 0 };
+#ifdef SM3TOOLS_SSE2
+    if (count >= 8) {
+        const __m128i ones { _mm_set1_epi16(1) };
+        const __m128i zero { _mm_setzero_si128() };
+        const __m128i clipHigh { _mm_set1_epi16(static_cast<short>(clipLevel - 1)) };
+        const __m128i clipLow { _mm_set1_epi16(static_cast<short>(-clipLevel + 1)) };
+        const __m128i loudHigh { _mm_set1_epi16(static_cast<short>(SILENCE_THRESHOLD)) };
+        const __m128i loudLow { _mm_set1_epi16(static_cast<short>(-SILENCE_THRESHOLD)) };
+        __m128i maxSamples { _mm_set1_epi16(-32768) };
+        __m128i minSamples { _mm_set1_epi16(32767) };
+        __m128i sumsOfSquares { zero };
+
+        //each 32 bit lane of the sums can grow by at most 65536 per step,
+        //so they are moved into the 64 bit total before they could overflow
+        constexpr std::size_t SUM_FLUSH_SAMPLES { 8 * 16384 };
+        std::size_t lastLoudVector { 0 };
+        int lastLoudMask { 0 };
+        while (i + 8 <= count) {
+            const std::size_t blockEnd { std::min(count - (count - i) % 8, i + SUM_FLUSH_SAMPLES) };
+            __m128i sums { zero };
+            for (; i < blockEnd; i += 8) {
+                const __m128i v { _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + i * 2)) };
+                maxSamples = _mm_max_epi16(maxSamples, v);
+                minSamples = _mm_min_epi16(minSamples, v);
+                sums = _mm_add_epi32(sums, _mm_madd_epi16(v, ones));
+                //at most 2 * 32768^2 per lane, which fits in an unsigned 32 bit lane
+                const __m128i squares { _mm_madd_epi16(v, v) };
+                sumsOfSquares = _mm_add_epi64(sumsOfSquares, _mm_unpacklo_epi32(squares, zero));
+                sumsOfSquares = _mm_add_epi64(sumsOfSquares, _mm_unpackhi_epi32(squares, zero));
+
+                const int clipMask { _mm_movemask_epi8(_mm_or_si128(
+                    _mm_cmpgt_epi16(v, clipHigh), _mm_cmplt_epi16(v, clipLow))) };
+                //two mask bits per sample
+                analyser.clippedSamples += std::bitset<16>(static_cast<unsigned>(clipMask)).count() / 2;
+
+                const int loudMask { _mm_movemask_epi8(_mm_or_si128(
+                    _mm_cmpgt_epi16(v, loudHigh), _mm_cmplt_epi16(v, loudLow))) };
+                if (loudMask != 0) {
+                    if (!analyser.foundLoudSample) {
+                        std::size_t lane { 0 };
+                        while ((loudMask & (1 << (lane * 2))) == 0) {
+                            lane++;
+                        }
+                        markLoudSample(analyser, firstIndex + i + lane);
+                    }
+                    lastLoudVector = i;
+                    lastLoudMask = loudMask;
+                }
+            }
+            alignas(16) std::array<std::int32_t, 4> laneSums {};
+            _mm_store_si128(reinterpret_cast<__m128i *>(laneSums.data()), sums);
+            for (const std::int32_t laneSum : laneSums) {
+                analyser.sum += laneSum;
+            }
+        }
+
+        if (lastLoudMask != 0) {
+            std::size_t lane { 7 };
+            while ((lastLoudMask & (1 << (lane * 2))) == 0) {
+                lane--;
+            }
+            markLoudSample(analyser, firstIndex + lastLoudVector + lane);
+        }
+
+        alignas(16) std::array<std::int16_t, 8> laneMax {};
+        alignas(16) std::array<std::int16_t, 8> laneMin {};
+        alignas(16) std::array<std::uint64_t, 2> laneSquares {};
+        _mm_store_si128(reinterpret_cast<__m128i *>(laneMax.data()), maxSamples);
+        _mm_store_si128(reinterpret_cast<__m128i *>(laneMin.data()), minSamples);
+        _mm_store_si128(reinterpret_cast<__m128i *>(laneSquares.data()), sumsOfSquares);
+        analyser.maxSample = std::max<std::int32_t>(analyser.maxSample, *std::max_element(laneMax.begin(), laneMax.end()));
+        analyser.minSample = std::min<std::int32_t>(analyser.minSample, *std::min_element(laneMin.begin(), laneMin.end()));
+        analyser.sumOfSquares += laneSquares[0] + laneSquares[1];
+    }
+#endif
+    for (; i < count; i++) {
+        const std::int32_t sample { static_cast<std::int16_t>(readLittleEndian<std::uint16_t>(samples, i * 2)) };
+        analyser.maxSample = std::max(analyser.maxSample, sample);
+        analyser.minSample = std::min(analyser.minSample, sample);
+        analyser.sum += sample;
+        analyser.sumOfSquares += static_cast<std::uint64_t>(sample * sample);
+        if (sample >= clipLevel || sample <= -clipLevel) {
+            analyser.clippedSamples++;
+        }
+        if (sample > SILENCE_THRESHOLD || sample < -SILENCE_THRESHOLD) {
+            markLoudSample(analyser, firstIndex + i);
+        }
+    }
+    analyser.sampleCount += count;
+}
+
+AudioAnalyser startAnalysis(const FSBHeader& header) {
+    AudioAnalyser analyser {};
+    analyser.header = header;
+    analyser.isPCM = isPCM(header);
+    return analyser;
+}
+
+void analyseChunk(AudioAnalyser& analyser, const unsigned char *const data, const std::size_t size) {
+    assert(data != nullptr || size == 0);
+
+    if (!analyser.isPCM) {
+        return;
+    }
+    if ((analyser.header.mode & FSBMode::BITS_8) == 0) {
+        analyseSamples16(analyser, data, size / 2, CLIP_LEVEL_16);
+        return;
+    }
+
+    const bool isUnsigned { (analyser.header.mode & FSBMode::UNSIGNED) != 0 };
+    std::array<unsigned char, WIDEN_BUFFER_SAMPLES * 2> widened {};
+    for (std::size_t start = 0; start < size; start += WIDEN_BUFFER_SAMPLES) {
+        const std::size_t count { std::min(WIDEN_BUFFER_SAMPLES, size - start) };
+        for (std::size_t i = 0; i < count; i++) {
+            const int sample { isUnsigned
+                ? static_cast<int>(data[start + i]) - 128
+                : static_cast<int>(static_cast<signed char>(data[start + i])) };
+            writeLittleEndian(widened.data(), i * 2, static_cast<std::uint16_t>(sample * 256));
+        }
+        analyseSamples16(analyser, widened.data(), count, CLIP_LEVEL_8);
+    }
+}
+
+AudioAnalysis finishAnalysis(const AudioAnalyser& analyser) {
+    AudioAnalysis analysis {};
+    analysis.name = analyser.header.fileName.data();
+    analysis.numChannels = channelCount(analyser.header);
+    analysis.sampleRate = analyser.header.frequency;
+    analysis.analysed = analyser.isPCM;
+    if (!analyser.isPCM || analyser.sampleCount == 0) {
+        return analysis;
+    }
+
+    constexpr double FULL_SCALE { 32768.0 };
+    const auto sampleCount { static_cast<double>(analyser.sampleCount) };
+    analysis.frameCount = analyser.sampleCount / analysis.numChannels;
+    analysis.peak = std::max(analyser.maxSample, -analyser.minSample) / FULL_SCALE;
+    analysis.rms = std::sqrt(static_cast<double>(analyser.sumOfSquares) / sampleCount) / FULL_SCALE;
+    analysis.dcOffset = static_cast<double>(analyser.sum) / sampleCount / FULL_SCALE;
+    analysis.clippedSamples = analyser.clippedSamples;
+    if (analyser.foundLoudSample) {
+        const std::uint64_t firstLoudFrame { analyser.firstLoudSample / analysis.numChannels };
+        const std::uint64_t lastLoudFrame { analyser.lastLoudSample / analysis.numChannels };
+        analysis.leadingSilenceFrames = firstLoudFrame;
+        analysis.trailingSilenceFrames = analysis.frameCount > lastLoudFrame
+            ? analysis.frameCount - lastLoudFrame - 1 : 0;
+    }
+    else {
+        analysis.leadingSilenceFrames = analysis.frameCount;
+        analysis.trailingSilenceFrames = analysis.frameCount;
+    }
+    return analysis;
+}
+
+AudioAnalysis analyseAudio(const FSBHeader& header, const unsigned char *const data, const std::size_t size) {
+    AudioAnalyser analyser { startAnalysis(header) };
+    analyseChunk(analyser, data, size);
+    return finishAnalysis(analyser);
+}
+
+static double toDBFS(const double level) {
+    return level > 0.0 ? std::max(SILENT_DBFS, 20.0 * std::log10(level)) : SILENT_DBFS;
+}
+
+//FSB names are at most 30 characters and normally plain ASCII,
+//but are escaped anyway so that the report is always valid
+static std::string escapeJSON(const std::string_view text) {
+    std::string escaped {};
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8] {};
+            (void) std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(c));
+            escaped += code;
+        }
+        else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static std::string quoteCSV(const std::string_view text) {
+    std::string quoted { "\"" };
+    for (const char c : text) {
+        if (c == '"') {
+            quoted += '"';
+        }
+        quoted += c;
+    }
+    quoted += '"';
+    return quoted;
+}
+
+void writeAnalysisReport(const std::vector<AudioAnalysis>& analyses, const std::string& filePath) {
+    assert(!filePath.empty());
+
+    const bool isJSON { std::filesystem::path(filePath).extension() == ".json" };
+    std::FILE *const reportHandle { MyIO::fopen(filePath.c_str(), "w") };
+    if (isJSON) {
+        (void) std::fprintf(reportHandle, "[\n");
+    }
+    else {
+        (void) std::fprintf(reportHandle, "name,analysed,channels,sample_rate,frames,peak,peak_dbfs,"
+            "rms,rms_dbfs,dc_offset,leading_silence_frames,trailing_silence_frames,clipped_samples\n");
+    }
+
+    for (std::size_t i = 0; i < analyses.size(); i++) {
+        const AudioAnalysis& analysis { analyses[i] };
+        //NOTE: casts to unsigned long long avoid needing to import <inttypes.h>
+        if (isJSON) {
+            (void) std::fprintf(reportHandle,
+                "  {\"name\": \"%s\", \"analysed\": %s, \"channels\": %u, \"sample_rate\": %lu, "
+                "\"frames\": %llu, \"peak\": %.6f, \"peak_dbfs\": %.2f, \"rms\": %.6f, \"rms_dbfs\": %.2f, "
+                "\"dc_offset\": %.6f, \"leading_silence_frames\": %llu, \"trailing_silence_frames\": %llu, "
+                "\"clipped_samples\": %llu}%s\n",
+                escapeJSON(analysis.name).c_str(),
+                analysis.analysed ? "true" : "false",
+                static_cast<unsigned>(analysis.numChannels),
+                static_cast<unsigned long>(analysis.sampleRate),
+                static_cast<unsigned long long>(analysis.frameCount),
+                analysis.peak, toDBFS(analysis.peak), analysis.rms, toDBFS(analysis.rms), analysis.dcOffset,
+                static_cast<unsigned long long>(analysis.leadingSilenceFrames),
+                static_cast<unsigned long long>(analysis.trailingSilenceFrames),
+                static_cast<unsigned long long>(analysis.clippedSamples),
+                i + 1 < analyses.size() ? "," : "");
+        }
+        else if (analysis.analysed) {
+            (void) std::fprintf(reportHandle, "%s,1,%u,%lu,%llu,%.6f,%.2f,%.6f,%.2f,%.6f,%llu,%llu,%llu\n",
+                quoteCSV(analysis.name).c_str(),
+                static_cast<unsigned>(analysis.numChannels),
+                static_cast<unsigned long>(analysis.sampleRate),
+                static_cast<unsigned long long>(analysis.frameCount),
+                analysis.peak, toDBFS(analysis.peak), analysis.rms, toDBFS(analysis.rms), analysis.dcOffset,
+                static_cast<unsigned long long>(analysis.leadingSilenceFrames),
+                static_cast<unsigned long long>(analysis.trailingSilenceFrames),
+                static_cast<unsigned long long>(analysis.clippedSamples));
+        }
+        else {
+            //the measurements are left empty for audio that wasn't analysed
+            (void) std::fprintf(reportHandle, "%s,0,%u,%lu,,,,,,,,,\n",
+                quoteCSV(analysis.name).c_str(),
+                static_cast<unsigned>(analysis.numChannels),
+                static_cast<unsigned long>(analysis.sampleRate));
+        }
+    }
+
+    if (isJSON) {
+        (void) std::fprintf(reportHandle, "]\n");
+    }
+    (void) std::fflush(reportHandle);
+    if (std::ferror(reportHandle)) {
+        std::perror("ERROR: Failed to write analysis report");
+        std::exit(EXIT_FAILURE);
+    }
+    (void) std::fclose(reportHandle);
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "pcssb.hpp"
+
+//samples with an absolute value at or below this (in 16 bit terms, about -60 dBFS)
+//count as silence
+constexpr std::int32_t SILENCE_THRESHOLD { 32 };
+
+//level and quality measurements of the audio of one FSB.
+//levels are fractions of full scale (1.0 is the loudest a sample can be).
+struct AudioAnalysis {
+    std::string name {}; // FSB file name
+    bool analysed { false }; // false if the FSB isn't PCM, in which case the measurements are all 0
+    std::uint16_t numChannels {};
+    std::uint32_t sampleRate {};
+    std::uint64_t frameCount {};
+    double peak {}; // highest absolute sample value
+    double rms {}; // root mean square of every sample
+    double dcOffset {}; // mean sample value
+    std::uint64_t leadingSilenceFrames {}; // frames before the first sample above SILENCE_THRESHOLD
+    std::uint64_t trailingSilenceFrames {}; // frames after the last sample above SILENCE_THRESHOLD
+    std::uint64_t clippedSamples {}; // samples at (or within one step of) full scale
+};
+
+//running totals of an analysis that is given the audio data in chunks.
+//start with startAnalysis, pass every chunk in order to analyseChunk, then call finishAnalysis.
+struct AudioAnalyser {
+    FSBHeader header {};
+    bool isPCM { false };
+    std::int32_t maxSample { 0 };
+    std::int32_t minSample { 0 };
+    std::int64_t sum { 0 };
+    std::uint64_t sumOfSquares { 0 };
+    std::uint64_t sampleCount { 0 };
+    std::uint64_t clippedSamples { 0 };
+    bool foundLoudSample { false };
+    std::uint64_t firstLoudSample { 0 };
+    std::uint64_t lastLoudSample { 0 };
+};
+
+AudioAnalyser startAnalysis(const FSBHeader& header);
+
+//adds size bytes of FSB audio data to the analysis. does nothing for FSBs that aren't PCM.
+//chunks of 16 bit audio must have an even size (apart from the last one).
+void analyseChunk(AudioAnalyser& analyser, const unsigned char *data, std::size_t size);
+
+AudioAnalysis finishAnalysis(const AudioAnalyser& analyser);
+
+//analyses all of the audio data of an FSB at once
+AudioAnalysis analyseAudio(const FSBHeader& header, const unsigned char *data, std::size_t size);
+
+//writes the analyses to filePath as JSON if it ends in .json, or CSV otherwise.
+//logs the error and exits if the file can't be written.
+void writeAnalysisReport(const std::vector<AudioAnalysis>& analyses, const std::string& filePath);
+
+#endif
@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARCHIVEENGINE_H
+#define ARCHIVEENGINE_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include "myIO.hpp"
+#include "parallel.hpp"
+#include "archiveformat.hpp"
+
+//Engines for finding the entries of an archive, shared by every format
+//(see archiveformat.hpp for what a format has to provide).
+
+//size of the ranges of the file searched by each thread in findNextMagicParallel
+constexpr std::size_t PARALLEL_SCAN_MIN_RANGE_SIZE { 4 * 1024 * 1024 };
+
+//how far forEachArchiveEntry searches on its own thread when falling back to searching
+//for the magic text, before handing the rest of the file to findNextMagicParallel
+constexpr std::size_t SERIAL_SCAN_LIMIT { 1024 * 1024 };
+
+//size of the blocks read when falling back to searching for the magic text.
+//kept small because the next header is normally close by (e.g. after a partial duplicate)
+constexpr std::size_t MAGIC_SCAN_BLOCK_SIZE { 4 * 1024 };
+
+//number of bytes read from a stream at once
+constexpr std::size_t STREAM_READ_SIZE { 64 * 1024 };
+
+//searches the mapped file from startPosition onwards for the next Format::MAGIC text.
+//the file is split into ranges of PARALLEL_SCAN_MIN_RANGE_SIZE bytes which are searched
+//on separate threads, workerCount() ranges at a time, stopping after the first batch
+//of ranges that has a match in it.
+//returns the absolute position of the match, or std::string_view::npos if there is none.
+template <typename Format>
+std::size_t findNextMagicParallel(const MyIO::FileView& view, const std::size_t startPosition) {
+    static_assert(isValidArchiveFormat<Format>());
+
+    const std::string_view fileSV { reinterpret_cast<const char *>(view.data), view.size };
+    const std::size_t batchRangeCount { workerCount() };
+
+    //each range owns the matches that start inside it, but is searched a little
+    //past its end so a match crossing into the next range is still found.
+    //a match starting in that overlap belongs to the next range, so it is left to it
+    constexpr std::size_t OVERLAP { Format::MAGIC.size() - 1 };
+    for (std::size_t batchStart = startPosition; batchStart < fileSV.size();
+        batchStart += batchRangeCount * PARALLEL_SCAN_MIN_RANGE_SIZE) {
+
+        std::vector<std::size_t> rangeMatches(batchRangeCount, std::string_view::npos);
+        parallelFor(batchRangeCount, [&](const std::size_t r) {
+            const std::size_t rangeStart { batchStart + r * PARALLEL_SCAN_MIN_RANGE_SIZE };
+            if (rangeStart >= fileSV.size()) {
+                return;
+            }
+            const std::size_t rangeEnd { std::min(rangeStart + PARALLEL_SCAN_MIN_RANGE_SIZE, fileSV.size()) };
+            const std::string_view rangeSV { fileSV.substr(rangeStart,
+                std::min(rangeEnd + OVERLAP, fileSV.size()) - rangeStart) };
+            const std::size_t matchIndex { rangeSV.find(Format::MAGIC) };
+            if (matchIndex != std::string_view::npos && rangeStart + matchIndex < rangeEnd) {
+                rangeMatches[r] = rangeStart + matchIndex;
+            }
+        });
+
+        //the ranges are in file order, so the first one with a match has the next match
+        for (const std::size_t match : rangeMatches) {
+            if (match != std::string_view::npos) {
+                return match;
+            }
+        }
+    }
+    return std::string_view::npos;
+}
+
+//searches the file from startPosition up to endPosition (normally the file size)
+//for the next Format::MAGIC text, reading MAGIC_SCAN_BLOCK_SIZE bytes at a time.
+//returns the absolute position of the match, or std::string_view::npos if there is none.
+template <typename Format>
+std::size_t findNextMagic(
+    std::FILE *const fileHandle,
+    const std::size_t startPosition,
+    const std::size_t endPosition) {
+
+    assert(fileHandle != nullptr);
+
+    constexpr std::size_t OVERLAP { Format::MAGIC.size() - 1 };
+    std::vector<char> buffer(MAGIC_SCAN_BLOCK_SIZE + OVERLAP);
+
+    std::size_t blockPosition { startPosition };
+    while (blockPosition + Format::MAGIC.size() <= endPosition) {
+        const std::size_t readCount { std::min(buffer.size(), endPosition - blockPosition) };
+        MyIO::fseekunsigned(fileHandle, blockPosition, SEEK_SET);
+        const std::size_t numRead { MyIO::fread(buffer.data(), sizeof(char), readCount, fileHandle) };
+
+        const std::string_view blockSV { buffer.data(), numRead };
+        const std::size_t matchIndex { blockSV.find(Format::MAGIC) };
+        if (matchIndex != std::string_view::npos) {
+            return blockPosition + matchIndex;
+        }
+        if (numRead < readCount) {
+            break;
+        }
+        //the blocks overlap so a match split across two blocks is still found
+        blockPosition += numRead - OVERLAP;
+    }
+    return std::string_view::npos;
+}
+
+//reads and decodes the header at position if there is a valid one there.
+template <typename Format>
+bool tryReadHeader(
+    std::FILE *const fileHandle,
+    const std::size_t position,
+    const std::size_t fileSize,
+    typename Format::Header& header) {
+
+    if (position + Format::HEADER_SIZE > fileSize) {
+        return false;
+    }
+
+    std::array<unsigned char, Format::HEADER_SIZE> buffer {};
+    MyIO::fseekunsigned(fileHandle, position, SEEK_SET);
+    const std::size_t numRead { MyIO::fread(buffer.data(), sizeof(char), buffer.size(), fileHandle) };
+    if (numRead != buffer.size()
+        || std::memcmp(buffer.data(), Format::MAGIC.data(), Format::MAGIC.size()) != 0) {
+        return false;
+    }
+
+    header = Format::decodeHeader(buffer.data());
+    return Format::isValidHeader(header);
+}
+
+//calls callback(const ArchiveEntry<Format>&) with each entry of the archive at filePath
+//(skipping partial duplicates) as soon as it is found. if callback returns false
+//the rest of the file isn't read.
+//Rather than searching every byte, this follows the structure of the archive:
+//after reading a header it jumps over the header and data to where the next entry
+//should be. The file is only searched for the magic text when that jump doesn't land
+//on a valid header (e.g. after a partial duplicate, or when a data size is wrong),
+//and then only from the end of the current header up to the next match. That search
+//is done in parallel (see findNextMagicParallel) past the first SERIAL_SCAN_LIMIT bytes,
+//for when the next header is a long way off in a large archive.
+template <typename Format, typename Callback>
+void forEachArchiveEntry(const std::string& filePath, Callback&& callback) {
+    static_assert(isValidArchiveFormat<Format>());
+    assert(!filePath.empty());
+
+    using Header = typename Format::Header;
+    const auto fileSize = static_cast<std::size_t>(MyIO::getfilesize(filePath.c_str()));
+
+    //the last entry that wasn't a duplicate, and whether the last entry that
+    //was found was a duplicate (so that the entry after a duplicate is never
+    //treated as one as well)
+    bool hasPrevious { false };
+    Header previous {};
+    bool lastWasDuplicate { false };
+
+    //only mapped once a search goes past SERIAL_SCAN_LIMIT
+    MyIO::FileView view {};
+
+    std::FILE *const fileHandle { MyIO::fopen(filePath.c_str(), "rb") };
+    const auto searchFrom = [&](const std::size_t startPosition) {
+        //the serial search goes on far enough to find a match starting
+        //anywhere before the point the parallel one starts from
+        const std::size_t serialEnd { std::min(fileSize, startPosition + SERIAL_SCAN_LIMIT + Format::MAGIC.size() - 1) };
+        const std::size_t match { findNextMagic<Format>(fileHandle, startPosition, serialEnd) };
+        if (match != std::string_view::npos || serialEnd == fileSize) {
+            return match;
+        }
+        if (view.data == nullptr) {
+            view = MyIO::mapfile(filePath.c_str());
+        }
+        return findNextMagicParallel<Format>(view, startPosition + SERIAL_SCAN_LIMIT);
+    };
+    {
+        std::size_t position { searchFrom(0) };
+        while (position != std::string_view::npos) {
+            Header header {};
+            if (!tryReadHeader<Format>(fileHandle, position, fileSize, header)) {
+                //magic text inside some data rather than a real header, keep searching
+                position = searchFrom(position + Format::MAGIC.size());
+                continue;
+            }
+
+            const bool isDuplicate { hasPrevious && !lastWasDuplicate
+                && Format::isPartialDuplicate(header, previous) };
+
+            //the partial duplicates can keep the full data size, so it is not followed
+            //for them (it can land on a header further on and skip entries)
+            const std::size_t expectedNextPosition { position + Format::HEADER_SIZE + Format::dataSize(header) };
+            Header nextHeader {};
+            const bool nextFound { !isDuplicate
+                && tryReadHeader<Format>(fileHandle, expectedNextPosition, fileSize, nextHeader) };
+
+            if (!isDuplicate) {
+                hasPrevious = true;
+                previous = header;
+                if (!callback(ArchiveEntry<Format> { position, header,
+                    nextFound || expectedNextPosition == fileSize })) {
+                    break;
+                }
+            }
+            lastWasDuplicate = isDuplicate;
+
+            if (nextFound) {
+                position = expectedNextPosition;
+            }
+            else {
+                //the data size didn't lead to another header (or this is a partial duplicate),
+                //so search from the end of this header instead
+                position = searchFrom(position + Format::HEADER_SIZE);
+            }
+        }
+    }
+    (void) std::fclose(fileHandle);
+    MyIO::unmapfile(view);
+}
+
+//the part of a stream that has been read but not used up yet.
+//position is the absolute position in the stream of buffer[start].
+struct StreamWindow {
+    std::FILE *stream { nullptr };
+    std::vector<unsigned char> buffer {};
+    std::size_t start { 0 };
+    std::size_t end { 0 };
+    std::size_t position { 0 };
+    bool atEnd { false };
+};
+
+//reads from the stream until at least count bytes are in the window
+//(or the stream ends), returning the number of bytes in the window.
+//the buffer only grows as big as the largest count asked for (or STREAM_READ_SIZE).
+inline std::size_t fillStreamWindow(StreamWindow& window, const std::size_t count) {
+    if (window.end - window.start >= count || window.atEnd) {
+        return window.end - window.start;
+    }
+
+    //move what is left to the front rather than growing the buffer
+    if (window.start > 0) {
+        std::memmove(window.buffer.data(), window.buffer.data() + window.start, window.end - window.start);
+        window.end -= window.start;
+        window.start = 0;
+    }
+    if (window.buffer.size() < std::max(count, STREAM_READ_SIZE)) {
+        window.buffer.resize(std::max(count, STREAM_READ_SIZE));
+    }
+
+    while (window.end < count && !window.atEnd) {
+        const std::size_t readCount { window.buffer.size() - window.end };
+        const std::size_t numRead { MyIO::fread(window.buffer.data() + window.end, sizeof(char), readCount, window.stream) };
+        window.end += numRead;
+        //errors exit in MyIO::fread, so a short read is the end of the stream
+        window.atEnd = numRead < readCount;
+    }
+    return window.end - window.start;
+}
+
+inline void consumeStreamWindow(StreamWindow& window, const std::size_t count) {
+    assert(count <= window.end - window.start);
+    window.start += count;
+    window.position += count;
+}
+
+//moves the start of the window to the next Format::MAGIC text in the stream.
+//returns false if the stream ends without another one.
+template <typename Format>
+bool skipToNextMagic(StreamWindow& window) {
+    constexpr std::size_t OVERLAP { Format::MAGIC.size() - 1 };
+    while (true) {
+        const std::size_t available { fillStreamWindow(window, STREAM_READ_SIZE) };
+        const std::string_view windowSV {
+            reinterpret_cast<const char *>(window.buffer.data() + window.start), available };
+        const std::size_t matchIndex { windowSV.find(Format::MAGIC) };
+        if (matchIndex != std::string_view::npos) {
+            consumeStreamWindow(window, matchIndex);
+            return true;
+        }
+        if (window.atEnd) {
+            return false;
+        }
+        //keep the end in case the text is split across reads
+        consumeStreamWindow(window, available - OVERLAP);
+    }
+}
+
+//decodes the header offset bytes into the window, returning whether there is a valid one there
+template <typename Format>
+bool tryDecodeHeader(
+    const StreamWindow& window,
+    const std::size_t offset,
+    const std::size_t available,
+    typename Format::Header& header) {
+
+    if (offset + Format::HEADER_SIZE > available) {
+        return false;
+    }
+    const unsigned char *const bytes { window.buffer.data() + window.start + offset };
+    if (std::memcmp(bytes, Format::MAGIC.data(), Format::MAGIC.size()) != 0) {
+        return false;
+    }
+    header = Format::decodeHeader(bytes);
+    return Format::isValidHeader(header);
+}
+
+//same as forEachArchiveEntry, but for a stream that can only be read forwards once
+//(e.g. standard input or a pipe). callback(const ArchiveEntry<Format>&, const unsigned char *data,
+//std::size_t dataSize) is also given the entry's data, which is only valid during the call
+//and can be shorter than the data size in the header if the stream ended early.
+//headerPosition is counted from the start of the stream.
+template <typename Format, typename Callback>
+void forEachArchiveEntryInStream(std::FILE *const stream, Callback&& callback) {
+    static_assert(isValidArchiveFormat<Format>());
+    assert(stream != nullptr);
+
+    using Header = typename Format::Header;
+
+    StreamWindow window {};
+    window.stream = stream;
+
+    //same as in forEachArchiveEntry
+    bool hasPrevious { false };
+    Header previous {};
+    bool lastWasDuplicate { false };
+
+    bool found { skipToNextMagic<Format>(window) };
+    while (found) {
+        Header header {};
+        if (!tryDecodeHeader<Format>(window, 0, fillStreamWindow(window, Format::HEADER_SIZE), header)) {
+            //magic text inside some data rather than a real header, keep searching
+            consumeStreamWindow(window, Format::MAGIC.size());
+            found = skipToNextMagic<Format>(window);
+            continue;
+        }
+
+        const bool isDuplicate { hasPrevious && !lastWasDuplicate
+            && Format::isPartialDuplicate(header, previous) };
+
+        //everything up to the end of the next header is kept in the window,
+        //so the most that is ever buffered is one entry's data plus two headers
+        const std::size_t dataSize { Format::dataSize(header) };
+        const std::size_t nextOffset { Format::HEADER_SIZE + dataSize };
+        bool nextFound { false };
+        if (!isDuplicate) {
+            const std::size_t available { fillStreamWindow(window, nextOffset + Format::HEADER_SIZE) };
+            Header nextHeader {};
+            nextFound = tryDecodeHeader<Format>(window, nextOffset, available, nextHeader);
+
+            hasPrevious = true;
+            previous = header;
+            const bool dataSizeMatches { nextFound || (window.atEnd && available == nextOffset) };
+            const std::size_t dataAvailable { std::min(dataSize, available - Format::HEADER_SIZE) };
+            if (!callback(ArchiveEntry<Format> { window.position, header, dataSizeMatches },
+                window.buffer.data() + window.start + Format::HEADER_SIZE, dataAvailable)) {
+                break;
+            }
+        }
+        lastWasDuplicate = isDuplicate;
+
+        if (nextFound) {
+            consumeStreamWindow(window, nextOffset);
+        }
+        else {
+            //same as forEachArchiveEntry, the data that was read past this header
+            //is still in the window so it can be searched
+            consumeStreamWindow(window, Format::HEADER_SIZE);
+            found = skipToNextMagic<Format>(window);
+        }
+    }
+}
+
+#endif
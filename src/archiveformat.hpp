@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARCHIVEFORMAT_H
+#define ARCHIVEFORMAT_H
+#include <string_view>
+
+#include <cstddef>
+
+//The engines in archiveengine.hpp (finding headers, walking the entries of an
+//archive and reading one from a stream) are templates over a format, so every
+//kind of archive shares the same code for finding its entries and the format's
+//functions are called directly (and inlined) rather than through function
+//pointers or virtual calls.
+//only finding entries is shared: what is done with them afterwards (e.g. extracting
+//and converting the audio, or patching the data size fields when replacing it) is
+//still written for each format, as it is for PCSSBs in pcssb.cpp.
+//
+//A format is a struct (e.g. PCSSBFormat in pcssb.hpp) with these static members:
+//  Header                  - decoded copy of an entry's header (plain data)
+//  MAGIC                   - constexpr text at the start of every entry's header
+//  HEADER_SIZE             - constexpr size in bytes of an entry's header, which comes straight
+//                            before the entry's data
+//  decodeHeader(bytes)     - decodes the HEADER_SIZE bytes at bytes (starting with MAGIC) into a Header
+//  isValidHeader(header)   - whether a decoded header is real rather than MAGIC text
+//                            that happens to be inside some data
+//  dataSize(header)        - number of bytes of data that follow the header
+//  entryName(header)       - null terminated name of the entry
+//  isPartialDuplicate(header, previous)
+//                          - whether the entry is a partial copy of the entry before it
+//                            (which is skipped, and whose data size isn't followed)
+
+//an entry of an archive in Format, found by one of the engines in archiveengine.hpp.
+template <typename Format>
+struct ArchiveEntry {
+    std::size_t headerPosition {}; // absolute position of the MAGIC text at the start of the header
+    typename Format::Header header {};
+    //whether the next entry (or the end of the file) was found exactly where
+    //the header and data size fields said it would be
+    bool dataSizeMatches {};
+};
+
+//checks the constant parts of a format that the engines rely on.
+template <typename Format>
+constexpr bool isValidArchiveFormat() {
+    return !Format::MAGIC.empty() && Format::HEADER_SIZE >= Format::MAGIC.size();
+}
+
+#endif
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bundle.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <array>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "bytes.hpp"
+
+static std::size_t alignUp(const std::size_t value, const std::uint32_t alignment) {
+    return (value + alignment - 1) & ~std::size_t { alignment - 1U };
+}
+
+void writeBundle(
+    std::vector<BundleInput> inputs,
+    const std::string& outputFilePath,
+    const std::uint32_t alignment) {
+
+    assert(!outputFilePath.empty());
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+    //stable so that inputs with the same name stay in the order they were given, and then
+    //only the last of them is kept, the same one that ends up in the file when extracting
+    std::stable_sort(inputs.begin(), inputs.end(), [](const BundleInput& lhs, const BundleInput& rhs) {
+        return lhs.name < rhs.name;
+    });
+    inputs.erase(inputs.begin(), std::unique(inputs.rbegin(), inputs.rend(), [](const BundleInput& lhs, const BundleInput& rhs) {
+        return lhs.name == rhs.name;
+    }).base());
+
+    //work out where each sample goes first so the whole table can be written up front
+    const std::size_t entryTableOffset { BUNDLE_HEADER_SIZE };
+    std::size_t dataOffset { entryTableOffset + inputs.size() * BUNDLE_ENTRY_SIZE };
+    std::vector<unsigned char> tables(dataOffset, 0);
+    std::vector<std::size_t> dataOffsets(inputs.size());
+
+    for (std::size_t i = 0; i < inputs.size(); i++) {
+        if (inputs[i].name.size() > BUNDLE_NAME_SIZE) {
+            std::cerr << "ERROR: Sample name " << inputs[i].name << " is too long for a bundle!\n";
+            std::exit(EXIT_FAILURE);
+        }
+        dataOffset = alignUp(dataOffset, alignment);
+        dataOffsets[i] = dataOffset;
+
+        unsigned char *const record { tables.data() + entryTableOffset + i * BUNDLE_ENTRY_SIZE };
+        std::memcpy(record + BundleEntryField::NAME, inputs[i].name.data(), inputs[i].name.size());
+        writeLittleEndian<std::uint64_t>(record, BundleEntryField::DATA_OFFSET, dataOffset);
+        writeLittleEndian<std::uint64_t>(record, BundleEntryField::DATA_SIZE, inputs[i].size);
+
+        dataOffset += inputs[i].size;
+    }
+
+    std::memcpy(tables.data() + BundleField::MAGIC, BUNDLE_MAGIC_STRING.data(), BUNDLE_MAGIC_STRING.size());
+    writeLittleEndian(tables.data(), BundleField::ENTRY_COUNT, static_cast<std::uint32_t>(inputs.size()));
+    writeLittleEndian(tables.data(), BundleField::ALIGNMENT, alignment);
+    writeLittleEndian<std::uint64_t>(tables.data(), BundleField::ENTRY_TABLE_OFFSET, entryTableOffset);
+    writeLittleEndian<std::uint64_t>(tables.data(), BundleField::FILE_SIZE, dataOffset);
+
+    std::FILE *const outputFileHandle { MyIO::fopen(outputFilePath.c_str(), "wb") };
+    {
+        (void) MyIO::fwrite(tables.data(), sizeof(char), tables.size(), outputFileHandle);
+
+        std::size_t position { tables.size() };
+        const std::vector<char> padding(alignment, '\0');
+        std::vector<char> buffer {};
+        for (std::size_t i = 0; i < inputs.size(); i++) {
+            if (dataOffsets[i] > position) {
+                (void) MyIO::fwrite(padding.data(), sizeof(char), dataOffsets[i] - position, outputFileHandle);
+            }
+            position = dataOffsets[i] + inputs[i].size;
+            if (inputs[i].size == 0) {
+                continue;
+            }
+
+            //NOTE: zero filled so a truncated source still gives a sample of the listed size
+            buffer.assign(inputs[i].size, '\0');
+            std::FILE *const inputFileHandle { MyIO::fopen(inputs[i].sourceFilePath.c_str(), "rb") };
+            {
+                MyIO::fseekunsigned(inputFileHandle, inputs[i].sourcePosition, SEEK_SET);
+                (void) MyIO::fread(buffer.data(), sizeof(char), buffer.size(), inputFileHandle);
+            }
+            (void) std::fclose(inputFileHandle);
+            (void) MyIO::fwrite(buffer.data(), sizeof(char), buffer.size(), outputFileHandle);
+        }
+    }
+    (void) std::fclose(outputFileHandle);
+}
+
+Bundle openBundle(const std::string& filePath) {
+    assert(!filePath.empty());
+
+    Bundle bundle {};
+    bundle.view = MyIO::mapfile(filePath.c_str());
+    const MyIO::FileView& view { bundle.view };
+
+    bool isValid { view.size >= BUNDLE_HEADER_SIZE
+        && std::memcmp(view.data, BUNDLE_MAGIC_STRING.data(), BUNDLE_MAGIC_STRING.size()) == 0 };
+    if (isValid) {
+        bundle.entryCount = readLittleEndian<std::uint32_t>(view.data, BundleField::ENTRY_COUNT);
+        bundle.entryTableOffset = readLittleEndian<std::uint64_t>(view.data, BundleField::ENTRY_TABLE_OFFSET);
+        isValid = bundle.entryTableOffset + std::uint64_t { bundle.entryCount } * BUNDLE_ENTRY_SIZE <= view.size
+            && readLittleEndian<std::uint64_t>(view.data, BundleField::FILE_SIZE) <= view.size;
+    }
+    if (!isValid) {
+        std::cerr << "ERROR: " << filePath << " is not a valid bundle file!\n";
+        closeBundle(bundle);
+        std::exit(EXIT_FAILURE);
+    }
+
+    return bundle;
+}
+
+void closeBundle(Bundle& bundle) {
+    MyIO::unmapfile(bundle.view);
+    bundle = Bundle {};
+}
+
+std::size_t bundleSampleCount(const Bundle& bundle) {
+    return bundle.entryCount;
+}
+
+//name stored in an entry record, without the null padding
+static std::string_view entryName(const unsigned char *const record) {
+    const char *const name { reinterpret_cast<const char *>(record + BundleEntryField::NAME) };
+    const void *const terminator { std::memchr(name, '\0', BUNDLE_NAME_SIZE) };
+    const std::size_t length { terminator == nullptr
+        ? BUNDLE_NAME_SIZE : static_cast<std::size_t>(static_cast<const char *>(terminator) - name) };
+    return { name, length };
+}
+
+BundleSample bundleSampleAt(const Bundle& bundle, const std::size_t index) {
+    assert(index < bundle.entryCount);
+
+    const unsigned char *const record { bundle.view.data + bundle.entryTableOffset + index * BUNDLE_ENTRY_SIZE };
+    const auto dataOffset { readLittleEndian<std::uint64_t>(record, BundleEntryField::DATA_OFFSET) };
+    const auto dataSize { readLittleEndian<std::uint64_t>(record, BundleEntryField::DATA_SIZE) };
+
+    //never hand out memory past the end of the mapping, even for a corrupt entry
+    const std::size_t mappedSize { bundle.view.size };
+    const std::size_t start { dataOffset > mappedSize ? mappedSize : static_cast<std::size_t>(dataOffset) };
+    const std::size_t size { dataSize > mappedSize - start ? mappedSize - start : static_cast<std::size_t>(dataSize) };
+
+    return { entryName(record), bundle.view.data + start, size };
+}
+
+std::optional<BundleSample> findBundleSample(const Bundle& bundle, const std::string_view name) {
+    //binary search for the first entry not ordered before name
+    std::size_t low { 0 };
+    std::size_t high { bundle.entryCount };
+    while (low < high) {
+        const std::size_t middle { low + (high - low) / 2 };
+        const unsigned char *const record { bundle.view.data + bundle.entryTableOffset + middle * BUNDLE_ENTRY_SIZE };
+        if (entryName(record) < name) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+
+    if (low < bundle.entryCount) {
+        const BundleSample sample { bundleSampleAt(bundle, low) };
+        if (sample.name == name) {
+            return sample;
+        }
+    }
+    return std::nullopt;
+}
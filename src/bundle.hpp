@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUNDLE_H
+#define BUNDLE_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "myIO.hpp"
+
+//A bundle holds extracted samples in a single file that can be memory mapped
+//and searched by name without reading the rest of the file.
+//
+//Layout (all integers little-endian):
+//  header (BUNDLE_HEADER_SIZE bytes, offsets given by BundleField)
+//  entry table: one BUNDLE_ENTRY_SIZE record per sample, sorted by name
+//      (byte-wise) so it can be binary searched. names are unique
+//  sample data, each sample starting on a multiple of the alignment
+
+// text at the start of each bundle file, includes the format version
+constexpr std::string_view BUNDLE_MAGIC_STRING { "SM3BND01" };
+
+//default alignment of sample data, the page size on most systems
+constexpr std::uint32_t BUNDLE_DEFAULT_ALIGNMENT { 4096 };
+
+constexpr std::size_t BUNDLE_HEADER_SIZE { 32 };
+namespace BundleField {
+    constexpr std::size_t MAGIC { 0 };
+    constexpr std::size_t ENTRY_COUNT { 8 }; // uint32
+    constexpr std::size_t ALIGNMENT { 12 }; // uint32
+    constexpr std::size_t ENTRY_TABLE_OFFSET { 16 }; // uint64
+    constexpr std::size_t FILE_SIZE { 24 }; // uint64
+}
+
+//names are stored in a fixed size null padded field, which fits any FSB name
+constexpr std::size_t BUNDLE_NAME_SIZE { 32 };
+constexpr std::size_t BUNDLE_ENTRY_SIZE { 48 };
+namespace BundleEntryField {
+    constexpr std::size_t NAME { 0 }; // BUNDLE_NAME_SIZE bytes
+    constexpr std::size_t DATA_OFFSET { 32 }; // uint64, from the start of the bundle
+    constexpr std::size_t DATA_SIZE { 40 }; // uint64
+}
+
+//a sample to write into a bundle, copied from part of another file
+struct BundleInput {
+    std::string name {}; // at most BUNDLE_NAME_SIZE bytes
+    std::string sourceFilePath {};
+    std::size_t sourcePosition {};
+    std::size_t size {};
+};
+
+//writes inputs into a bundle file at outputFilePath (overwriting it if it exists),
+//with each sample's data aligned to alignment bytes (which must be a power of two).
+//inputs are sorted by name in the bundle. if more than one input has the same name,
+//only the last of them in inputs is written (like extracting them to files one at a time).
+void writeBundle(
+    std::vector<BundleInput> inputs,
+    const std::string& outputFilePath,
+    std::uint32_t alignment = BUNDLE_DEFAULT_ALIGNMENT);
+
+//an open bundle, mapped into memory
+struct Bundle {
+    MyIO::FileView view {};
+    std::uint32_t entryCount {};
+    std::uint64_t entryTableOffset {};
+};
+
+//a sample in an open bundle. data points directly into the mapping
+//so it is only valid until the bundle is closed.
+struct BundleSample {
+    std::string_view name {};
+    const unsigned char *data {};
+    std::size_t size {};
+};
+
+//maps the bundle at filePath into memory and checks that it is valid.
+//logs the error and exits if it isn't.
+//NOTE: the bundle has to be closed with closeBundle after you're done using it.
+Bundle openBundle(const std::string& filePath);
+
+//unmaps the bundle. samples returned from it are no longer valid afterwards.
+void closeBundle(Bundle& bundle);
+
+//number of samples in the bundle.
+std::size_t bundleSampleCount(const Bundle& bundle);
+
+//the sample at index (in name order), index must be less than bundleSampleCount.
+BundleSample bundleSampleAt(const Bundle& bundle, std::size_t index);
+
+//finds a sample by its exact name using a binary search.
+//returns nothing if there is no sample with that name.
+std::optional<BundleSample> findBundleSample(const Bundle& bundle, std::string_view name);
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BYTES_H
+#define BYTES_H
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+//reads a little-endian unsigned integer of type T from bytes + offset.
+//done byte by byte so that it is independent of host endianness and alignment.
+template <typename T>
+T readLittleEndian(const unsigned char *const bytes, const std::size_t offset) {
+    T value { 0 };
+    for (std::size_t i = 0; i < sizeof(T); i++) {
+        value = static_cast<T>(value | static_cast<T>(bytes[offset + i]) << (8 * i));
+    }
+    return value;
+}
+
+//writes value as a little-endian unsigned integer to bytes + offset.
+template <typename T>
+void writeLittleEndian(unsigned char *const bytes, const std::size_t offset, const T value) {
+    for (std::size_t i = 0; i < sizeof(T); i++) {
+        bytes[offset + i] = static_cast<unsigned char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+//reads a little-endian IEEE 754 float from bytes + offset.
+inline float readLittleEndianFloat(const unsigned char *const bytes, const std::size_t offset) {
+    static_assert(sizeof(float) == sizeof(std::uint32_t));
+    const std::uint32_t bits { readLittleEndian<std::uint32_t>(bytes, offset) };
+    float value {};
+    std::memcpy(&value, &bits, sizeof(float));
+    return value;
+}
+
+#endif
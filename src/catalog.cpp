@@ -0,0 +1,647 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "catalog.hpp"
+
+#include <iostream>
+#include <filesystem>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "pcssb.hpp"
+#include "wav.hpp"
+#include "myIO.hpp"
+#include "bytes.hpp"
+#include "parallel.hpp"
+
+//number of bloom filter bits used per entry, and the number of hashes per name.
+//together these give a false positive rate of roughly 1%
+constexpr std::size_t BLOOM_BITS_PER_ENTRY { 10 };
+constexpr std::uint32_t BLOOM_HASH_COUNT { 7 };
+//largest power of two that fits in the uint32 bit count (a 256 MiB filter).
+//past this the false positive rate goes up, but lookups still give the right answer
+constexpr std::uint32_t MAX_BLOOM_BIT_COUNT { 1U << 31 };
+
+struct CatalogEntry {
+    std::string name {};
+    std::uint64_t headerPosition {};
+    std::uint32_t dataSize {};
+    ContentFingerprint rawFingerprint {};
+    bool hasWavFingerprint { false };
+    ContentFingerprint wavFingerprint {};
+};
+
+struct CatalogArchive {
+    std::string path {};
+    std::uint64_t modifiedTime {};
+    std::uint64_t fileSize {};
+    std::vector<CatalogEntry> entries {};
+};
+
+std::uint64_t catalogNameHash(const std::string_view name) {
+    std::uint64_t hash { 14695981039346656037ULL };
+    for (const char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+//spreads the bits of value over the whole word (the splitmix64 finaliser).
+static std::uint64_t mixHash(std::uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+//64 bit hash of size bytes at data, starting from seed.
+//works on 8 bytes at a time so that hashing all of the audio in an archive
+//costs about as much as reading it.
+static std::uint64_t hashBytes(const unsigned char *const data, const std::size_t size, const std::uint64_t seed) {
+    constexpr std::uint64_t MULTIPLIER { 0x9E3779B97F4A7C15ULL };
+
+    const auto step = [](const std::uint64_t hash, const std::uint64_t word) {
+        const std::uint64_t mixed { hash ^ (word * MULTIPLIER) };
+        return ((mixed << 29) | (mixed >> 35)) * 0xC2B2AE3D27D4EB4FULL;
+    };
+
+    std::uint64_t hash { seed };
+    std::size_t i { 0 };
+    for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t)) {
+        hash = step(hash, readLittleEndian<std::uint64_t>(data, i));
+    }
+    if (i < size) {
+        std::uint64_t tail { 0 };
+        for (std::size_t j = 0; i + j < size; j++) {
+            tail |= std::uint64_t { data[i + j] } << (8 * j);
+        }
+        hash = step(hash, tail);
+    }
+    return mixHash(hash ^ size);
+}
+
+//prefix hash of a file of size bytes, data only has to hold the first FINGERPRINT_PREFIX_SIZE of them.
+//the size is mixed in so that files which only share their start are told apart too.
+static std::uint64_t prefixHash(const unsigned char *const data, const std::size_t size) {
+    return hashBytes(data, std::min(size, FINGERPRINT_PREFIX_SIZE), mixHash(size));
+}
+
+ContentFingerprint catalogContentFingerprint(const unsigned char *const data, const std::size_t size) {
+    //a different seed from the prefix hash, so small files don't get the same value for both
+    constexpr std::uint64_t CONTENT_SEED { 0x5350A3C1D2E4F607ULL };
+    return { prefixHash(data, size), hashBytes(data, size, CONTENT_SEED) };
+}
+
+//index of the i-th bloom filter bit for a name hash (using double hashing).
+//bitCount must be a power of two.
+static std::uint32_t bloomBitIndex(
+    const std::uint64_t hash,
+    const std::uint32_t i,
+    const std::uint32_t bitCount) {
+
+    const auto h1 { static_cast<std::uint32_t>(hash) };
+    const auto h2 { static_cast<std::uint32_t>(hash >> 32) | 1U };
+    return (h1 + i * h2) & (bitCount - 1);
+}
+
+//a string from the string pool of a catalog that has passed isValidCatalog.
+//a reference that doesn't lie inside the pool (in a corrupt catalog) gives an
+//empty string instead of reading past it.
+static std::string_view catalogString(
+    const MyIO::FileView& view,
+    const std::uint32_t offset,
+    const std::uint32_t length) {
+
+    const auto strings { readLittleEndian<std::uint64_t>(view.data, CatalogField::STRINGS_OFFSET) };
+    const auto stringsSize { readLittleEndian<std::uint64_t>(view.data, CatalogField::STRINGS_SIZE) };
+    if (std::uint64_t { offset } + length > stringsSize) {
+        return {};
+    }
+    return { reinterpret_cast<const char *>(view.data + strings + offset), length };
+}
+
+//checks the header of a mapped catalog, and that every table it
+//points to lies inside the file.
+static bool isValidCatalog(const MyIO::FileView& view) {
+    if (view.size < CATALOG_HEADER_SIZE
+        || std::memcmp(view.data, CATALOG_MAGIC_STRING.data(), CATALOG_MAGIC_STRING.size()) != 0) {
+        return false;
+    }
+    const auto archiveCount { readLittleEndian<std::uint32_t>(view.data, CatalogField::ARCHIVE_COUNT) };
+    const auto entryCount { readLittleEndian<std::uint32_t>(view.data, CatalogField::ENTRY_COUNT) };
+    const auto bloomBitCount { readLittleEndian<std::uint32_t>(view.data, CatalogField::BLOOM_BIT_COUNT) };
+    const auto archiveTable { readLittleEndian<std::uint64_t>(view.data, CatalogField::ARCHIVE_TABLE_OFFSET) };
+    const auto entryTable { readLittleEndian<std::uint64_t>(view.data, CatalogField::ENTRY_TABLE_OFFSET) };
+    const auto bloom { readLittleEndian<std::uint64_t>(view.data, CatalogField::BLOOM_OFFSET) };
+    const auto strings { readLittleEndian<std::uint64_t>(view.data, CatalogField::STRINGS_OFFSET) };
+    const auto stringsSize { readLittleEndian<std::uint64_t>(view.data, CatalogField::STRINGS_SIZE) };
+    const auto fingerprintCount { readLittleEndian<std::uint32_t>(view.data, CatalogField::FINGERPRINT_COUNT) };
+    const auto fingerprintTable { readLittleEndian<std::uint64_t>(view.data, CatalogField::FINGERPRINT_TABLE_OFFSET) };
+
+    //written so that nonsense offsets can't overflow and wrap around into range
+    const auto fitsInFile = [&view](const std::uint64_t offset, const std::uint64_t size) {
+        return offset <= view.size && size <= view.size - offset;
+    };
+
+    return bloomBitCount != 0
+        && (bloomBitCount & (bloomBitCount - 1)) == 0
+        && fitsInFile(archiveTable, std::uint64_t { archiveCount } * CATALOG_ARCHIVE_RECORD_SIZE)
+        && fitsInFile(entryTable, std::uint64_t { entryCount } * CATALOG_ENTRY_RECORD_SIZE)
+        && fitsInFile(fingerprintTable, std::uint64_t { fingerprintCount } * CATALOG_FINGERPRINT_RECORD_SIZE)
+        && fitsInFile(bloom, bloomBitCount / 8)
+        && fitsInFile(strings, stringsSize);
+}
+
+//reads an existing catalog back into memory so that its unchanged archives can be reused.
+//returns an empty list if there is no catalog or it isn't valid.
+static std::vector<CatalogArchive> loadCatalog(const std::string& catalogPath) {
+    std::vector<CatalogArchive> archives {};
+    if (!std::filesystem::is_regular_file(catalogPath)) {
+        return archives;
+    }
+
+    MyIO::FileView view { MyIO::mapfile(catalogPath.c_str()) };
+    if (!isValidCatalog(view)) {
+        std::cout << "LOG: Existing catalog is not valid, rebuilding it from scratch.\n";
+        MyIO::unmapfile(view);
+        return archives;
+    }
+
+    const auto archiveCount { readLittleEndian<std::uint32_t>(view.data, CatalogField::ARCHIVE_COUNT) };
+    const auto entryCount { readLittleEndian<std::uint32_t>(view.data, CatalogField::ENTRY_COUNT) };
+    const auto archiveTable { readLittleEndian<std::uint64_t>(view.data, CatalogField::ARCHIVE_TABLE_OFFSET) };
+    const auto entryTable { readLittleEndian<std::uint64_t>(view.data, CatalogField::ENTRY_TABLE_OFFSET) };
+    const auto fingerprintCount { readLittleEndian<std::uint32_t>(view.data, CatalogField::FINGERPRINT_COUNT) };
+    const auto fingerprintTable { readLittleEndian<std::uint64_t>(view.data, CatalogField::FINGERPRINT_TABLE_OFFSET) };
+
+    archives.resize(archiveCount);
+    for (std::uint32_t i = 0; i < archiveCount; i++) {
+        const unsigned char *const record { view.data + archiveTable + std::uint64_t { i } * CATALOG_ARCHIVE_RECORD_SIZE };
+        archives[i].modifiedTime = readLittleEndian<std::uint64_t>(record, CatalogArchiveField::MODIFIED_TIME);
+        archives[i].fileSize = readLittleEndian<std::uint64_t>(record, CatalogArchiveField::FILE_SIZE);
+        archives[i].path = catalogString(view,
+            readLittleEndian<std::uint32_t>(record, CatalogArchiveField::PATH_OFFSET),
+            readLittleEndian<std::uint32_t>(record, CatalogArchiveField::PATH_LENGTH));
+    }
+    //where each record in the entry table ended up, so its fingerprints can be put back with it
+    std::vector<std::pair<std::uint32_t, std::size_t>> entryLocations(entryCount, { archiveCount, 0 });
+    for (std::uint32_t i = 0; i < entryCount; i++) {
+        const unsigned char *const record { view.data + entryTable + std::uint64_t { i } * CATALOG_ENTRY_RECORD_SIZE };
+        const auto archiveIndex { readLittleEndian<std::uint32_t>(record, CatalogEntryField::ARCHIVE_INDEX) };
+        if (archiveIndex >= archiveCount) {
+            continue;
+        }
+        entryLocations[i] = { archiveIndex, archives[archiveIndex].entries.size() };
+        archives[archiveIndex].entries.push_back({
+            std::string { catalogString(view,
+                readLittleEndian<std::uint32_t>(record, CatalogEntryField::NAME_OFFSET),
+                readLittleEndian<std::uint32_t>(record, CatalogEntryField::NAME_LENGTH)) },
+            readLittleEndian<std::uint64_t>(record, CatalogEntryField::HEADER_POSITION),
+            readLittleEndian<std::uint32_t>(record, CatalogEntryField::DATA_SIZE) });
+    }
+    for (std::uint32_t i = 0; i < fingerprintCount; i++) {
+        const unsigned char *const record { view.data + fingerprintTable + std::uint64_t { i } * CATALOG_FINGERPRINT_RECORD_SIZE };
+        const auto entryIndex { readLittleEndian<std::uint32_t>(record, CatalogFingerprintField::ENTRY_INDEX) };
+        if (entryIndex >= entryCount || entryLocations[entryIndex].first >= archiveCount) {
+            continue;
+        }
+        CatalogEntry& entry { archives[entryLocations[entryIndex].first].entries[entryLocations[entryIndex].second] };
+        const ContentFingerprint fingerprint {
+            readLittleEndian<std::uint64_t>(record, CatalogFingerprintField::PREFIX_HASH),
+            readLittleEndian<std::uint64_t>(record, CatalogFingerprintField::CONTENT_HASH) };
+        if (readLittleEndian<std::uint32_t>(record, CatalogFingerprintField::KIND)
+            == static_cast<std::uint32_t>(CatalogFingerprintKind::wav)) {
+            entry.hasWavFingerprint = true;
+            entry.wavFingerprint = fingerprint;
+        }
+        else {
+            entry.rawFingerprint = fingerprint;
+        }
+    }
+
+    MyIO::unmapfile(view);
+    return archives;
+}
+
+//serialises archives into the catalog format and writes it to outputPath.
+static void writeCatalog(const std::vector<CatalogArchive>& archives, const std::string& outputPath) {
+    struct SortableEntry {
+        std::uint64_t hash;
+        std::uint32_t archiveIndex;
+        const CatalogEntry *entry;
+    };
+
+    std::vector<SortableEntry> sortedEntries {};
+    std::string strings {};
+    for (std::size_t a = 0; a < archives.size(); a++) {
+        for (const CatalogEntry& entry : archives[a].entries) {
+            sortedEntries.push_back({ catalogNameHash(entry.name), static_cast<std::uint32_t>(a), &entry });
+        }
+    }
+    std::sort(sortedEntries.begin(), sortedEntries.end(), [](const SortableEntry& lhs, const SortableEntry& rhs) {
+        if (lhs.hash != rhs.hash) {
+            return lhs.hash < rhs.hash;
+        }
+        return lhs.entry->name < rhs.entry->name;
+    });
+
+    struct SortableFingerprint {
+        ContentFingerprint fingerprint;
+        std::uint32_t entryIndex;
+        CatalogFingerprintKind kind;
+    };
+
+    std::vector<SortableFingerprint> sortedFingerprints {};
+    for (std::size_t e = 0; e < sortedEntries.size(); e++) {
+        const CatalogEntry& entry { *sortedEntries[e].entry };
+        const auto entryIndex { static_cast<std::uint32_t>(e) };
+        sortedFingerprints.push_back({ entry.rawFingerprint, entryIndex, CatalogFingerprintKind::raw });
+        if (entry.hasWavFingerprint) {
+            sortedFingerprints.push_back({ entry.wavFingerprint, entryIndex, CatalogFingerprintKind::wav });
+        }
+    }
+    std::sort(sortedFingerprints.begin(), sortedFingerprints.end(),
+        [](const SortableFingerprint& lhs, const SortableFingerprint& rhs) {
+            if (lhs.fingerprint.prefixHash != rhs.fingerprint.prefixHash) {
+                return lhs.fingerprint.prefixHash < rhs.fingerprint.prefixHash;
+            }
+            if (lhs.fingerprint.contentHash != rhs.fingerprint.contentHash) {
+                return lhs.fingerprint.contentHash < rhs.fingerprint.contentHash;
+            }
+            return lhs.entryIndex < rhs.entryIndex;
+        });
+
+    //worked out in 64 bits since the count is stored as a uint32, it stops at MAX_BLOOM_BIT_COUNT
+    std::uint64_t wantedBloomBitCount { 64 };
+    while (wantedBloomBitCount < std::uint64_t { sortedEntries.size() } * BLOOM_BITS_PER_ENTRY
+        && wantedBloomBitCount < MAX_BLOOM_BIT_COUNT) {
+        wantedBloomBitCount *= 2;
+    }
+    const auto bloomBitCount { static_cast<std::uint32_t>(wantedBloomBitCount) };
+
+    const std::size_t archiveTable { CATALOG_HEADER_SIZE };
+    const std::size_t entryTable { archiveTable + archives.size() * CATALOG_ARCHIVE_RECORD_SIZE };
+    const std::size_t fingerprintTable { entryTable + sortedEntries.size() * CATALOG_ENTRY_RECORD_SIZE };
+    const std::size_t bloom { fingerprintTable + sortedFingerprints.size() * CATALOG_FINGERPRINT_RECORD_SIZE };
+    const std::size_t stringsOffset { bloom + bloomBitCount / 8 };
+
+    std::vector<unsigned char> tables(stringsOffset, 0);
+    unsigned char *const bytes { tables.data() };
+
+    for (std::size_t a = 0; a < archives.size(); a++) {
+        unsigned char *const record { bytes + archiveTable + a * CATALOG_ARCHIVE_RECORD_SIZE };
+        writeLittleEndian<std::uint64_t>(record, CatalogArchiveField::MODIFIED_TIME, archives[a].modifiedTime);
+        writeLittleEndian<std::uint64_t>(record, CatalogArchiveField::FILE_SIZE, archives[a].fileSize);
+        writeLittleEndian(record, CatalogArchiveField::PATH_OFFSET, static_cast<std::uint32_t>(strings.size()));
+        writeLittleEndian(record, CatalogArchiveField::PATH_LENGTH, static_cast<std::uint32_t>(archives[a].path.size()));
+        strings += archives[a].path;
+    }
+
+    for (std::size_t e = 0; e < sortedEntries.size(); e++) {
+        const SortableEntry& sortedEntry { sortedEntries[e] };
+        unsigned char *const record { bytes + entryTable + e * CATALOG_ENTRY_RECORD_SIZE };
+        writeLittleEndian(record, CatalogEntryField::NAME_HASH, sortedEntry.hash);
+        writeLittleEndian<std::uint64_t>(record, CatalogEntryField::HEADER_POSITION, sortedEntry.entry->headerPosition);
+        writeLittleEndian(record, CatalogEntryField::DATA_SIZE, sortedEntry.entry->dataSize);
+        writeLittleEndian(record, CatalogEntryField::ARCHIVE_INDEX, sortedEntry.archiveIndex);
+        writeLittleEndian(record, CatalogEntryField::NAME_OFFSET, static_cast<std::uint32_t>(strings.size()));
+        writeLittleEndian(record, CatalogEntryField::NAME_LENGTH, static_cast<std::uint32_t>(sortedEntry.entry->name.size()));
+        strings += sortedEntry.entry->name;
+
+        for (std::uint32_t i = 0; i < BLOOM_HASH_COUNT; i++) {
+            const std::uint32_t bit { bloomBitIndex(sortedEntry.hash, i, bloomBitCount) };
+            bytes[bloom + bit / 8] = static_cast<unsigned char>(bytes[bloom + bit / 8] | (1U << (bit % 8)));
+        }
+    }
+
+    for (std::size_t f = 0; f < sortedFingerprints.size(); f++) {
+        const SortableFingerprint& sortedFingerprint { sortedFingerprints[f] };
+        unsigned char *const record { bytes + fingerprintTable + f * CATALOG_FINGERPRINT_RECORD_SIZE };
+        writeLittleEndian(record, CatalogFingerprintField::PREFIX_HASH, sortedFingerprint.fingerprint.prefixHash);
+        writeLittleEndian(record, CatalogFingerprintField::CONTENT_HASH, sortedFingerprint.fingerprint.contentHash);
+        writeLittleEndian(record, CatalogFingerprintField::ENTRY_INDEX, sortedFingerprint.entryIndex);
+        writeLittleEndian(record, CatalogFingerprintField::KIND, static_cast<std::uint32_t>(sortedFingerprint.kind));
+    }
+
+    std::memcpy(bytes + CatalogField::MAGIC, CATALOG_MAGIC_STRING.data(), CATALOG_MAGIC_STRING.size());
+    writeLittleEndian(bytes, CatalogField::ARCHIVE_COUNT, static_cast<std::uint32_t>(archives.size()));
+    writeLittleEndian(bytes, CatalogField::ENTRY_COUNT, static_cast<std::uint32_t>(sortedEntries.size()));
+    writeLittleEndian(bytes, CatalogField::BLOOM_BIT_COUNT, bloomBitCount);
+    writeLittleEndian(bytes, CatalogField::BLOOM_HASH_COUNT, BLOOM_HASH_COUNT);
+    writeLittleEndian<std::uint64_t>(bytes, CatalogField::ARCHIVE_TABLE_OFFSET, archiveTable);
+    writeLittleEndian<std::uint64_t>(bytes, CatalogField::ENTRY_TABLE_OFFSET, entryTable);
+    writeLittleEndian<std::uint64_t>(bytes, CatalogField::BLOOM_OFFSET, bloom);
+    writeLittleEndian<std::uint64_t>(bytes, CatalogField::STRINGS_OFFSET, stringsOffset);
+    writeLittleEndian<std::uint64_t>(bytes, CatalogField::STRINGS_SIZE, strings.size());
+    writeLittleEndian(bytes, CatalogField::FINGERPRINT_COUNT, static_cast<std::uint32_t>(sortedFingerprints.size()));
+    writeLittleEndian<std::uint64_t>(bytes, CatalogField::FINGERPRINT_TABLE_OFFSET, fingerprintTable);
+
+    std::FILE *const fileHandle { MyIO::fopen(outputPath.c_str(), "wb") };
+    {
+        (void) MyIO::fwrite(tables.data(), sizeof(char), tables.size(), fileHandle);
+        if (!strings.empty()) {
+            (void) MyIO::fwrite(strings.data(), sizeof(char), strings.size(), fileHandle);
+        }
+    }
+    (void) std::fclose(fileHandle);
+}
+
+void buildCatalog(const std::string& directory, const std::string& catalogPath) {
+    assert(!directory.empty());
+    assert(!catalogPath.empty());
+
+    //absolute paths are stored so that lookups work from any working directory
+    const std::vector<std::string> archivePaths {
+        findPCSSBFiles(std::filesystem::absolute(directory).lexically_normal().string()) };
+
+    std::vector<CatalogArchive> previousArchives { loadCatalog(catalogPath) };
+    std::unordered_map<std::string, CatalogArchive *> previousByPath {};
+    for (CatalogArchive& archive : previousArchives) {
+        previousByPath[archive.path] = &archive;
+    }
+
+    std::vector<CatalogArchive> archives(archivePaths.size());
+    std::vector<std::size_t> staleArchives {};
+    for (std::size_t i = 0; i < archivePaths.size(); i++) {
+        CatalogArchive& archive { archives[i] };
+        archive.path = archivePaths[i];
+        archive.modifiedTime = static_cast<std::uint64_t>(
+            std::filesystem::last_write_time(archive.path).time_since_epoch().count());
+        archive.fileSize = static_cast<std::uint64_t>(MyIO::getfilesize(archive.path.c_str()));
+
+        const auto previous { previousByPath.find(archive.path) };
+        if (previous != previousByPath.end()
+            && previous->second->modifiedTime == archive.modifiedTime
+            && previous->second->fileSize == archive.fileSize) {
+            archive.entries = std::move(previous->second->entries);
+        }
+        else {
+            staleArchives.push_back(i);
+        }
+    }
+
+    std::vector<std::vector<FSBEntry>> staleEntries(staleArchives.size());
+    parallelFor(staleArchives.size(), [&](const std::size_t i) {
+        CatalogArchive& archive { archives[staleArchives[i]] };
+        staleEntries[i] = readFSBEntries(archive.path);
+        for (const FSBEntry& fsbEntry : staleEntries[i]) {
+            archive.entries.push_back({ fsbEntry.header.fileName.data(), fsbEntry.headerPosition, fsbEntry.header.dataSize });
+        }
+    });
+
+    //fingerprint the audio of every new entry. the entries of all the archives are handed out
+    //together, so an archive much bigger than the rest doesn't leave the other workers idle
+    std::vector<MyIO::FileView> staleViews(staleArchives.size());
+    std::vector<std::pair<std::size_t, std::size_t>> fingerprintJobs {};
+    for (std::size_t i = 0; i < staleArchives.size(); i++) {
+        if (staleEntries[i].empty()) {
+            continue;
+        }
+        staleViews[i] = MyIO::mapfile(archives[staleArchives[i]].path.c_str());
+        for (std::size_t e = 0; e < staleEntries[i].size(); e++) {
+            fingerprintJobs.emplace_back(i, e);
+        }
+    }
+    parallelFor(fingerprintJobs.size(), [&](const std::size_t j) {
+        const auto [i, e] { fingerprintJobs[j] };
+        const MyIO::FileView& view { staleViews[i] };
+        const FSBEntry& fsbEntry { staleEntries[i][e] };
+        CatalogEntry& entry { archives[staleArchives[i]].entries[e] };
+
+        //the same bytes that extracting the FSB writes, which can be cut short by the end of the file
+        const std::size_t dataPosition { std::min(fsbEntry.headerPosition + FSB_HEADER_SIZE, view.size) };
+        const std::size_t dataSize { std::min<std::size_t>(fsbEntry.header.dataSize, view.size - dataPosition) };
+        entry.rawFingerprint = catalogContentFingerprint(view.data + dataPosition, dataSize);
+        if (isWavConvertible(fsbEntry.header)) {
+            std::vector<unsigned char> wavFile {};
+            convertWavData(fsbEntry.header, view.data + dataPosition, dataSize, wavFile);
+            entry.hasWavFingerprint = true;
+            entry.wavFingerprint = catalogContentFingerprint(wavFile.data(), wavFile.size());
+        }
+    });
+    for (MyIO::FileView& view : staleViews) {
+        MyIO::unmapfile(view);
+    }
+
+    std::cout << "INFO: Indexed " << staleArchives.size() << " archive(s), "
+        << (archives.size() - staleArchives.size()) << " unchanged.\n";
+
+    const std::string tempCatalogPath { catalogPath + ".tmp" };
+    writeCatalog(archives, tempCatalogPath);
+    std::filesystem::rename(tempCatalogPath, catalogPath);
+}
+
+bool lookupCatalog(const std::string& catalogPath, const std::string_view name) {
+    assert(!catalogPath.empty());
+
+    const auto startTime { std::chrono::steady_clock::now() };
+
+    MyIO::FileView view { MyIO::mapfile(catalogPath.c_str()) };
+    if (!isValidCatalog(view)) {
+        std::cerr << "ERROR: " << catalogPath << " is not a valid catalog file!\n";
+        MyIO::unmapfile(view);
+        std::exit(EXIT_FAILURE);
+    }
+
+    const auto archiveCount { readLittleEndian<std::uint32_t>(view.data, CatalogField::ARCHIVE_COUNT) };
+    const auto entryCount { readLittleEndian<std::uint32_t>(view.data, CatalogField::ENTRY_COUNT) };
+    const auto bloomBitCount { readLittleEndian<std::uint32_t>(view.data, CatalogField::BLOOM_BIT_COUNT) };
+    const auto bloomHashCount { readLittleEndian<std::uint32_t>(view.data, CatalogField::BLOOM_HASH_COUNT) };
+    const auto archiveTable { readLittleEndian<std::uint64_t>(view.data, CatalogField::ARCHIVE_TABLE_OFFSET) };
+    const auto entryTable { readLittleEndian<std::uint64_t>(view.data, CatalogField::ENTRY_TABLE_OFFSET) };
+    const auto bloom { readLittleEndian<std::uint64_t>(view.data, CatalogField::BLOOM_OFFSET) };
+
+    const std::uint64_t hash { catalogNameHash(name) };
+
+    //if any of the name's bits aren't set it definitely isn't in the catalog
+    bool maybePresent { true };
+    for (std::uint32_t i = 0; i < bloomHashCount && maybePresent; i++) {
+        const std::uint32_t bit { bloomBitIndex(hash, i, bloomBitCount) };
+        maybePresent = (view.data[bloom + bit / 8] & (1U << (bit % 8))) != 0;
+    }
+
+    const auto entryRecord = [&](const std::uint32_t index) {
+        return view.data + entryTable + std::uint64_t { index } * CATALOG_ENTRY_RECORD_SIZE;
+    };
+
+    std::size_t matchCount { 0 };
+    if (maybePresent) {
+        //binary search for the first entry with a matching hash
+        std::uint32_t low { 0 };
+        std::uint32_t high { entryCount };
+        while (low < high) {
+            const std::uint32_t middle { low + (high - low) / 2 };
+            if (readLittleEndian<std::uint64_t>(entryRecord(middle), CatalogEntryField::NAME_HASH) < hash) {
+                low = middle + 1;
+            }
+            else {
+                high = middle;
+            }
+        }
+
+        for (std::uint32_t i = low;
+            i < entryCount && readLittleEndian<std::uint64_t>(entryRecord(i), CatalogEntryField::NAME_HASH) == hash;
+            i++) {
+
+            const unsigned char *const record { entryRecord(i) };
+            const std::string_view entryName { catalogString(view,
+                readLittleEndian<std::uint32_t>(record, CatalogEntryField::NAME_OFFSET),
+                readLittleEndian<std::uint32_t>(record, CatalogEntryField::NAME_LENGTH)) };
+            const auto archiveIndex { readLittleEndian<std::uint32_t>(record, CatalogEntryField::ARCHIVE_INDEX) };
+            if (entryName != name || archiveIndex >= archiveCount) {
+                continue;
+            }
+
+            const unsigned char *const archiveRecord { view.data + archiveTable
+                + std::uint64_t { archiveIndex } * CATALOG_ARCHIVE_RECORD_SIZE };
+            const std::string archivePath { catalogString(view,
+                readLittleEndian<std::uint32_t>(archiveRecord, CatalogArchiveField::PATH_OFFSET),
+                readLittleEndian<std::uint32_t>(archiveRecord, CatalogArchiveField::PATH_LENGTH)) };
+
+            std::printf("%s: Offset (hexadecimal) = 0x%llX, FSB Data Size = %lu\n",
+                archivePath.c_str(),
+                static_cast<unsigned long long>(readLittleEndian<std::uint64_t>(record, CatalogEntryField::HEADER_POSITION)),
+                static_cast<unsigned long>(readLittleEndian<std::uint32_t>(record, CatalogEntryField::DATA_SIZE)));
+            matchCount++;
+        }
+    }
+
+    MyIO::unmapfile(view);
+
+    const auto elapsed { std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime) };
+    std::cout << "INFO: Found " << matchCount << " match(es) in "
+        << elapsed.count() << " microseconds.\n";
+
+    return matchCount > 0;
+}
+
+bool lookupCatalogContent(const std::string& catalogPath, const std::string& filePath) {
+    assert(!catalogPath.empty());
+    assert(!filePath.empty());
+
+    const auto startTime { std::chrono::steady_clock::now() };
+
+    MyIO::FileView view { MyIO::mapfile(catalogPath.c_str()) };
+    if (!isValidCatalog(view)) {
+        std::cerr << "ERROR: " << catalogPath << " is not a valid catalog file!\n";
+        MyIO::unmapfile(view);
+        std::exit(EXIT_FAILURE);
+    }
+
+    const auto archiveCount { readLittleEndian<std::uint32_t>(view.data, CatalogField::ARCHIVE_COUNT) };
+    const auto entryCount { readLittleEndian<std::uint32_t>(view.data, CatalogField::ENTRY_COUNT) };
+    const auto archiveTable { readLittleEndian<std::uint64_t>(view.data, CatalogField::ARCHIVE_TABLE_OFFSET) };
+    const auto entryTable { readLittleEndian<std::uint64_t>(view.data, CatalogField::ENTRY_TABLE_OFFSET) };
+    const auto fingerprintCount { readLittleEndian<std::uint32_t>(view.data, CatalogField::FINGERPRINT_COUNT) };
+    const auto fingerprintTable { readLittleEndian<std::uint64_t>(view.data, CatalogField::FINGERPRINT_TABLE_OFFSET) };
+
+    //only the start of the file is needed to find the candidates
+    const auto fileSize { static_cast<std::size_t>(MyIO::getfilesize(filePath.c_str())) };
+    std::vector<unsigned char> prefix(std::min(fileSize, FINGERPRINT_PREFIX_SIZE));
+    std::FILE *const fileHandle { MyIO::fopen(filePath.c_str(), "rb") };
+    {
+        prefix.resize(MyIO::fread(prefix.data(), sizeof(char), prefix.size(), fileHandle));
+    }
+    (void) std::fclose(fileHandle);
+    const std::uint64_t filePrefixHash { prefixHash(prefix.data(), fileSize) };
+
+    const auto fingerprintRecord = [&](const std::uint32_t index) {
+        return view.data + fingerprintTable + std::uint64_t { index } * CATALOG_FINGERPRINT_RECORD_SIZE;
+    };
+
+    //binary search for the first fingerprint with a matching prefix hash
+    std::uint32_t low { 0 };
+    std::uint32_t high { fingerprintCount };
+    while (low < high) {
+        const std::uint32_t middle { low + (high - low) / 2 };
+        if (readLittleEndian<std::uint64_t>(fingerprintRecord(middle), CatalogFingerprintField::PREFIX_HASH) < filePrefixHash) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+
+    std::size_t matchCount { 0 };
+    std::uint64_t fileContentHash { 0 };
+    bool hashedContent { false };
+    for (std::uint32_t i = low;
+        i < fingerprintCount
+            && readLittleEndian<std::uint64_t>(fingerprintRecord(i), CatalogFingerprintField::PREFIX_HASH) == filePrefixHash;
+        i++) {
+
+        //a candidate, so the whole file has to be hashed to confirm it (but only once)
+        if (!hashedContent) {
+            MyIO::FileView fileView { MyIO::mapfile(filePath.c_str()) };
+            fileContentHash = catalogContentFingerprint(fileView.data, fileView.size).contentHash;
+            MyIO::unmapfile(fileView);
+            hashedContent = true;
+        }
+
+        const unsigned char *const record { fingerprintRecord(i) };
+        const auto entryIndex { readLittleEndian<std::uint32_t>(record, CatalogFingerprintField::ENTRY_INDEX) };
+        if (readLittleEndian<std::uint64_t>(record, CatalogFingerprintField::CONTENT_HASH) != fileContentHash
+            || entryIndex >= entryCount) {
+            continue;
+        }
+
+        const unsigned char *const entryRecord { view.data + entryTable
+            + std::uint64_t { entryIndex } * CATALOG_ENTRY_RECORD_SIZE };
+        const auto archiveIndex { readLittleEndian<std::uint32_t>(entryRecord, CatalogEntryField::ARCHIVE_INDEX) };
+        if (archiveIndex >= archiveCount) {
+            continue;
+        }
+
+        const unsigned char *const archiveRecord { view.data + archiveTable
+            + std::uint64_t { archiveIndex } * CATALOG_ARCHIVE_RECORD_SIZE };
+        const std::string archivePath { catalogString(view,
+            readLittleEndian<std::uint32_t>(archiveRecord, CatalogArchiveField::PATH_OFFSET),
+            readLittleEndian<std::uint32_t>(archiveRecord, CatalogArchiveField::PATH_LENGTH)) };
+        const std::string entryName { catalogString(view,
+            readLittleEndian<std::uint32_t>(entryRecord, CatalogEntryField::NAME_OFFSET),
+            readLittleEndian<std::uint32_t>(entryRecord, CatalogEntryField::NAME_LENGTH)) };
+        const bool isWav { readLittleEndian<std::uint32_t>(record, CatalogFingerprintField::KIND)
+            == static_cast<std::uint32_t>(CatalogFingerprintKind::wav) };
+
+        std::printf("%s: Offset (hexadecimal) = 0x%llX, FSB Data Size = %lu, FSB File Name = %s%s\n",
+            archivePath.c_str(),
+            static_cast<unsigned long long>(readLittleEndian<std::uint64_t>(entryRecord, CatalogEntryField::HEADER_POSITION)),
+            static_cast<unsigned long>(readLittleEndian<std::uint32_t>(entryRecord, CatalogEntryField::DATA_SIZE)),
+            entryName.c_str(),
+            isWav ? " (converted to WAV)" : "");
+        matchCount++;
+    }
+
+    MyIO::unmapfile(view);
+
+    const auto elapsed { std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime) };
+    std::cout << "INFO: Found " << matchCount << " match(es) in "
+        << elapsed.count() << " microseconds.\n";
+
+    return matchCount > 0;
+}
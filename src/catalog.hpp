@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CATALOG_H
+#define CATALOG_H
+#include <string>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdint>
+
+//The catalog is a single file indexing the FSBs of every PCSSB in a directory tree,
+//so that the archive containing a sample can be found without scanning any archives.
+//
+//Layout (all integers little-endian):
+//  header (CATALOG_HEADER_SIZE bytes, offsets given by CatalogField)
+//  archive table: one CATALOG_ARCHIVE_RECORD_SIZE record per archive
+//  entry table: one CATALOG_ENTRY_RECORD_SIZE record per FSB, sorted by
+//      name hash and then by name so it can be binary searched
+//  fingerprint table: one CATALOG_FINGERPRINT_RECORD_SIZE record per FSB's audio data
+//      (and another for its WAV conversion, if it has one), sorted by prefix hash
+//      and then by content hash so files can be looked up by their contents
+//  bloom filter over the name hashes, used to reject names that aren't present
+//  string pool holding archive paths and FSB names (not null terminated)
+//
+//Everything is addressed by offsets so the file can be used directly from a
+//read-only memory mapping.
+
+// text at the start of each catalog file, includes the format version
+constexpr std::string_view CATALOG_MAGIC_STRING { "SM3CAT02" };
+
+constexpr std::size_t CATALOG_HEADER_SIZE { 80 };
+namespace CatalogField {
+    constexpr std::size_t MAGIC { 0 };
+    constexpr std::size_t ARCHIVE_COUNT { 8 }; // uint32
+    constexpr std::size_t ENTRY_COUNT { 12 }; // uint32
+    constexpr std::size_t BLOOM_BIT_COUNT { 16 }; // uint32, always a power of two
+    constexpr std::size_t BLOOM_HASH_COUNT { 20 }; // uint32
+    constexpr std::size_t ARCHIVE_TABLE_OFFSET { 24 }; // uint64
+    constexpr std::size_t ENTRY_TABLE_OFFSET { 32 }; // uint64
+    constexpr std::size_t BLOOM_OFFSET { 40 }; // uint64
+    constexpr std::size_t STRINGS_OFFSET { 48 }; // uint64
+    constexpr std::size_t STRINGS_SIZE { 56 }; // uint64
+    constexpr std::size_t FINGERPRINT_COUNT { 64 }; // uint32
+    constexpr std::size_t FINGERPRINT_TABLE_OFFSET { 72 }; // uint64
+}
+
+constexpr std::size_t CATALOG_ARCHIVE_RECORD_SIZE { 24 };
+namespace CatalogArchiveField {
+    constexpr std::size_t MODIFIED_TIME { 0 }; // uint64, archive mtime in filesystem clock ticks
+    constexpr std::size_t FILE_SIZE { 8 }; // uint64
+    constexpr std::size_t PATH_OFFSET { 16 }; // uint32, into the string pool
+    constexpr std::size_t PATH_LENGTH { 20 }; // uint32
+}
+
+constexpr std::size_t CATALOG_ENTRY_RECORD_SIZE { 32 };
+namespace CatalogEntryField {
+    constexpr std::size_t NAME_HASH { 0 }; // uint64
+    constexpr std::size_t HEADER_POSITION { 8 }; // uint64, position of "FSB3" in the archive
+    constexpr std::size_t DATA_SIZE { 16 }; // uint32
+    constexpr std::size_t ARCHIVE_INDEX { 20 }; // uint32
+    constexpr std::size_t NAME_OFFSET { 24 }; // uint32, into the string pool
+    constexpr std::size_t NAME_LENGTH { 28 }; // uint32
+}
+
+constexpr std::size_t CATALOG_FINGERPRINT_RECORD_SIZE { 24 };
+namespace CatalogFingerprintField {
+    constexpr std::size_t PREFIX_HASH { 0 }; // uint64, see catalogContentFingerprint
+    constexpr std::size_t CONTENT_HASH { 8 }; // uint64
+    constexpr std::size_t ENTRY_INDEX { 16 }; // uint32, into the entry table
+    constexpr std::size_t KIND { 20 }; // uint32, a CatalogFingerprintKind
+}
+
+//which extracted file a fingerprint is of
+enum class CatalogFingerprintKind : std::uint32_t {
+    raw = 0, // the FSB's audio data, as extracted with --format raw
+    wav = 1, // the WAV file made from it by --format wav
+};
+
+//number of bytes at the start of a file covered by the prefix hash
+constexpr std::size_t FINGERPRINT_PREFIX_SIZE { 4096 };
+
+struct ContentFingerprint {
+    //hash of the size and first FINGERPRINT_PREFIX_SIZE bytes, cheap to work out
+    //for a file that isn't in the catalog and used to find candidate matches
+    std::uint64_t prefixHash {};
+    //hash of all of the bytes, used to confirm a candidate
+    std::uint64_t contentHash {};
+};
+
+//fingerprint of size bytes at data, as stored in the catalog fingerprint table.
+ContentFingerprint catalogContentFingerprint(const unsigned char *data, std::size_t size);
+
+//64 bit FNV-1a hash of an FSB name, as stored in the catalog entry table.
+std::uint64_t catalogNameHash(std::string_view name);
+
+//indexes every PCSSB under directory (in parallel) and writes the catalog to catalogPath.
+//if a catalog already exists at catalogPath, archives whose modification time
+//and size haven't changed since it was written are not read again.
+//the catalog is written to a temporary file first and then renamed over the old one.
+void buildCatalog(const std::string& directory, const std::string& catalogPath);
+
+//prints the archive, header offset and data size of every FSB named name
+//in the catalog at catalogPath. returns false if there are no matches.
+bool lookupCatalog(const std::string& catalogPath, std::string_view name);
+
+//prints the archive, header offset, data size and name of every FSB whose audio data
+//(or WAV conversion) has exactly the same contents as the file at filePath, using the
+//catalog at catalogPath. only the first FINGERPRINT_PREFIX_SIZE bytes of the file are
+//read unless its prefix hash matches something. returns false if there are no matches.
+bool lookupCatalogContent(const std::string& catalogPath, const std::string& filePath);
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "filter.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+#include <cstdlib>
+
+#include "search.hpp"
+
+bool selectsEverything(const NameFilter& filter) {
+    return filter.includePatterns.empty()
+        && filter.excludePatterns.empty()
+        && filter.regexes.empty()
+        && filter.names.empty();
+}
+
+bool matchesNameFilter(const NameFilter& filter, const std::string_view name) {
+    const auto matchesPattern = [name](const std::string& pattern) {
+        return matchesGlob(pattern, name);
+    };
+
+    if (std::any_of(filter.excludePatterns.begin(), filter.excludePatterns.end(), matchesPattern)) {
+        return false;
+    }
+    if (filter.includePatterns.empty() && filter.regexes.empty() && filter.names.empty()) {
+        return true;
+    }
+    //cheapest checks first
+    return filter.names.count(std::string { name }) != 0
+        || std::any_of(filter.includePatterns.begin(), filter.includePatterns.end(), matchesPattern)
+        || std::any_of(filter.regexes.begin(), filter.regexes.end(), [name](const std::regex& regex) {
+            return std::regex_search(name.begin(), name.end(), regex);
+        });
+}
+
+std::regex compileNameRegex(const std::string& pattern) {
+    try {
+        return std::regex { pattern, std::regex::ECMAScript | std::regex::optimize };
+    }
+    catch (const std::regex_error& error) {
+        std::cerr << "ERROR: Invalid regular expression " << pattern << ": " << error.what() << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+void readNameList(const std::string& filePath, std::unordered_set<std::string>& names) {
+    std::ifstream nameList { filePath };
+    if (!nameList) {
+        std::cerr << "ERROR: Failed to open name list " << filePath << ".\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::string line {};
+    while (std::getline(nameList, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+        names.insert(line);
+    }
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <regex>
+#include <unordered_set>
+
+//selects FSBs by their file name.
+//a name is selected if it matches any of the include patterns, regexes or exact names
+//(or if none of those were given), and doesn't match any of the exclude patterns.
+struct NameFilter {
+    std::vector<std::string> includePatterns {}; // wildcard patterns, see matchesGlob
+    std::vector<std::string> excludePatterns {}; // wildcard patterns, see matchesGlob
+    std::vector<std::regex> regexes {}; // matched against any part of the name
+    std::unordered_set<std::string> names {}; // exact names
+};
+
+//whether the filter lets every name through (i.e. nothing was set)
+bool selectsEverything(const NameFilter& filter);
+
+//whether the FSB file name is selected by the filter
+bool matchesNameFilter(const NameFilter& filter, std::string_view name);
+
+//compiles an ECMAScript regular expression for NameFilter::regexes.
+//logs the error and exits if the expression isn't valid.
+std::regex compileNameRegex(const std::string& pattern);
+
+//reads a file with one exact FSB file name per line into names.
+//blank lines and lines starting with '#' are skipped, as are Windows line endings.
+//logs the error and exits if the file can't be opened.
+void readNameList(const std::string& filePath, std::unordered_set<std::string>& names);
+
+#endif
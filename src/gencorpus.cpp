@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//Generates a corpus of synthetic PCSSB archives for training profile guided
+//optimisation builds (see the pgo targets). The archives are laid out like the
+//Spider-Man 3 ones: some leading data, then each FSB followed by a partial duplicate of it,
+//with a mix of PCM, IMA ADPCM and MPEG flagged FSBs of varying sizes.
+//A replacement file that fits the first FSB of the first archive is also written,
+//for training replace mode.
+//
+//Usage: gencorpus <Output Directory> [Archive Count]
+
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <array>
+#include <cmath>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "pcssb.hpp"
+#include "wav.hpp"
+#include "bytes.hpp"
+
+constexpr std::size_t DEFAULT_ARCHIVE_COUNT { 8 };
+//number of bytes at the start of each archive before the first FSB
+constexpr std::size_t LEADING_DATA_SIZE { 128 };
+//number of audio data bytes kept in each partial duplicate
+constexpr std::size_t DUPLICATE_DATA_SIZE { 16 };
+
+static std::vector<unsigned char> buildHeader(
+    const std::string& name,
+    const std::uint32_t dataSize,
+    const std::uint32_t mode,
+    const std::uint16_t numChannels,
+    const std::uint32_t lengthSamples) {
+
+    std::vector<unsigned char> header(FSB_HEADER_SIZE, 0);
+    unsigned char *const bytes { header.data() };
+    std::memcpy(bytes + FSBField::MAGIC, FSB_MAGIC_STRING.data(), FSB_MAGIC_STRING.size());
+    writeLittleEndian<std::uint32_t>(bytes, FSBField::NUM_SAMPLES, 1);
+    writeLittleEndian<std::uint32_t>(bytes, FSBField::SAMPLE_HEADERS_SIZE, FSB_HEADER_SIZE - FSBField::ENTRY_SIZE);
+    writeLittleEndian(bytes, FSBField::DATA_SIZE, dataSize);
+    writeLittleEndian<std::uint32_t>(bytes, FSBField::VERSION, 0x00030001);
+    writeLittleEndian<std::uint16_t>(bytes, FSBField::ENTRY_SIZE, FSB_HEADER_SIZE - FSBField::ENTRY_SIZE);
+    std::memcpy(bytes + FSBField::FILENAME, name.data(), std::min<std::size_t>(name.size(), FSB_FILENAME_SIZE));
+    writeLittleEndian(bytes, FSBField::LENGTH_SAMPLES, lengthSamples);
+    writeLittleEndian(bytes, FSBField::LENGTH_COMPRESSED, dataSize);
+    writeLittleEndian<std::uint32_t>(bytes, FSBField::LOOP_END, lengthSamples == 0 ? 0 : lengthSamples - 1);
+    writeLittleEndian(bytes, FSBField::MODE, mode);
+    writeLittleEndian<std::uint32_t>(bytes, FSBField::FREQUENCY, 48000);
+    writeLittleEndian<std::uint16_t>(bytes, FSBField::DEFAULT_VOLUME, 1);
+    writeLittleEndian<std::uint16_t>(bytes, FSBField::DEFAULT_PRIORITY, 128);
+    writeLittleEndian(bytes, FSBField::NUM_CHANNELS, numChannels);
+    writeLittleEndian<std::uint32_t>(bytes, FSBField::MIN_DISTANCE, 0x3F800000); // 1.0f
+    writeLittleEndian<std::uint32_t>(bytes, FSBField::MAX_DISTANCE, 0x461C4000); // 10000.0f
+    return header;
+}
+
+int main(const int argc, const char *const argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: gencorpus <Output Directory> [Archive Count]\n";
+        return EXIT_FAILURE;
+    }
+    const std::filesystem::path outputDirectory { argv[1] };
+    const std::size_t archiveCount { argc > 2 ? std::strtoul(argv[2], nullptr, 10) : DEFAULT_ARCHIVE_COUNT };
+    std::filesystem::create_directories(outputDirectory);
+
+    //fixed seed so every training run sees the same corpus
+    std::mt19937 random { 3 };
+    std::uniform_int_distribution<int> byteDistribution { 0, 255 };
+
+    for (std::size_t a = 0; a < archiveCount; a++) {
+        std::vector<unsigned char> archive(LEADING_DATA_SIZE, 0);
+        //a few archives have big streamed FSBs, the rest have many small ones
+        const bool isStreamed { a % 4 == 3 };
+        const std::size_t fsbCount { isStreamed ? 4U : 60U };
+        std::uniform_int_distribution<std::uint32_t> sizeDistribution {
+            isStreamed ? 1024U * 1024 : 512U, isStreamed ? 4U * 1024 * 1024 : 16U * 1024 };
+
+        for (std::size_t f = 0; f < fsbCount; f++) {
+            char name[64] {};
+            (void) std::snprintf(name, sizeof(name), "sample_%02zu_%03zu.wav", a, f);
+
+            std::uint32_t dataSize { sizeDistribution(random) };
+            std::vector<unsigned char> data {};
+            std::uint32_t mode {};
+            std::uint16_t numChannels {};
+            std::uint32_t lengthSamples {};
+            switch (f % 3) {
+                case 0: {
+                    //16 bit stereo PCM sine waves
+                    numChannels = 2;
+                    mode = FSBMode::BITS_16 | FSBMode::STEREO | FSBMode::SIGNED;
+                    dataSize -= dataSize % 4;
+                    lengthSamples = dataSize / 4;
+                    data.resize(dataSize);
+                    for (std::uint32_t i = 0; i < lengthSamples; i++) {
+                        const auto sample { static_cast<std::int16_t>(12000.0 * std::sin(i * 0.05)) };
+                        writeLittleEndian(data.data(), i * 4, static_cast<std::uint16_t>(sample));
+                        writeLittleEndian(data.data(), i * 4 + 2, static_cast<std::uint16_t>(-sample));
+                    }
+                    break;
+                }
+                case 1:
+                    //mono IMA ADPCM (random, but decodable)
+                    numChannels = 1;
+                    mode = FSBMode::IMAADPCM | FSBMode::MONO;
+                    dataSize -= static_cast<std::uint32_t>(dataSize % IMA_ADPCM_BLOCK_SIZE);
+                    lengthSamples = static_cast<std::uint32_t>(dataSize / IMA_ADPCM_BLOCK_SIZE * IMA_ADPCM_SAMPLES_PER_BLOCK);
+                    data.resize(dataSize);
+                    for (unsigned char& byte : data) {
+                        byte = static_cast<unsigned char>(byteDistribution(random));
+                    }
+                    for (std::size_t block = 0; block < dataSize; block += IMA_ADPCM_BLOCK_SIZE) {
+                        data[block + 2] = static_cast<unsigned char>(data[block + 2] % 89);
+                    }
+                    break;
+                default:
+                    //stereo MPEG, only ever extracted raw
+                    numChannels = 2;
+                    mode = FSBMode::MPEG | FSBMode::STEREO | 0x2000;
+                    lengthSamples = dataSize;
+                    data.resize(dataSize);
+                    for (unsigned char& byte : data) {
+                        byte = static_cast<unsigned char>(byteDistribution(random));
+                    }
+                    break;
+            }
+
+            const std::vector<unsigned char> header { buildHeader(name, dataSize, mode, numChannels, lengthSamples) };
+            archive.insert(archive.end(), header.begin(), header.end());
+            archive.insert(archive.end(), data.begin(), data.end());
+            //partial duplicate
+            archive.insert(archive.end(), header.begin(), header.end());
+            archive.insert(archive.end(), data.begin(), data.begin() + std::min<std::ptrdiff_t>(DUPLICATE_DATA_SIZE, static_cast<std::ptrdiff_t>(data.size())));
+
+            if (a == 0 && f == 0) {
+                std::filesystem::create_directories(outputDirectory / "replace");
+                std::ofstream replacement { outputDirectory / "replace" / name, std::ios::binary };
+                replacement.write(reinterpret_cast<const char *>(data.data()),
+                    static_cast<std::streamsize>(data.size() / 2));
+            }
+        }
+
+        char archiveName[64] {};
+        (void) std::snprintf(archiveName, sizeof(archiveName), "corpus_%02zu.pcssb", a);
+        std::ofstream output { outputDirectory / archiveName, std::ios::binary };
+        output.write(reinterpret_cast<const char *>(archive.data()), static_cast<std::streamsize>(archive.size()));
+    }
+
+    std::cout << "INFO: Generated " << archiveCount << " archive(s) in " << outputDirectory.string() << '\n';
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "modpack.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <set>
+#include <chrono>
+#include <random>
+#include <sstream>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "pcssb.hpp"
+#include "myIO.hpp"
+#include "parallel.hpp"
+
+//a PCSSB being modified by the mod pack
+struct ModPackTarget {
+    std::string archivePath {};
+    std::string stagedPath {}; // where the modified archive is written before committing
+    std::string backupPath {}; // where the original is kept while committing
+    std::vector<AudioReplacement> replacements {};
+    bool backupCreated { false }; // whether this install made backupPath (so it can be restored)
+};
+
+//suffixes for the temporary files kept next to each archive. they come after an id
+//that is different for every install, so files the user already has (e.g. their
+//own archive.pcssb.bak) are never overwritten, restored or deleted
+constexpr std::string_view STAGED_SUFFIX { ".tmp" };
+constexpr std::string_view BACKUP_SUFFIX { ".bak" };
+
+//tags at the start of each journal line
+constexpr std::string_view JOURNAL_TARGET_TAG { "T" }; // T <archive> <backup> <staged>
+constexpr std::string_view JOURNAL_BACKUP_TAG { "B" }; // B <backup>, once that backup is complete
+
+//reads the manifest into a list of replacements for each archive.
+//lists every problem with the manifest and exits if there are any.
+static std::map<std::string, std::vector<std::string>> readManifest(const std::string& manifestPath) {
+    std::ifstream manifest { manifestPath };
+    if (!manifest) {
+        std::cerr << "ERROR: Failed to open mod pack manifest " << manifestPath << "!\n";
+        std::exit(EXIT_FAILURE);
+    }
+    const std::filesystem::path baseDirectory { std::filesystem::path { manifestPath }.parent_path() };
+
+    std::map<std::string, std::vector<std::string>> replaceFilesByArchive {};
+    bool hasErrors { false };
+    std::string line {};
+    for (std::size_t lineNumber = 1; std::getline(manifest, line); lineNumber++) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        const std::size_t separator { line.find('\t') };
+        if (separator == std::string::npos) {
+            std::cerr << "ERROR: Line " << lineNumber << " of the manifest has no tab separating"
+                            " the archive and the audio file.\n";
+            hasErrors = true;
+            continue;
+        }
+
+        const std::filesystem::path archivePath { baseDirectory / line.substr(0, separator) };
+        const std::filesystem::path replaceFilePath { baseDirectory / line.substr(separator + 1) };
+        if (!std::filesystem::is_regular_file(archivePath) || !std::filesystem::is_regular_file(replaceFilePath)) {
+            std::cerr << "ERROR: Line " << lineNumber << " of the manifest refers to a file that doesn't exist.\n";
+            hasErrors = true;
+            continue;
+        }
+        //the same archive can be written different ways, so it's identified by its canonical path
+        replaceFilesByArchive[std::filesystem::canonical(archivePath).string()].push_back(replaceFilePath.string());
+    }
+
+    if (hasErrors) {
+        std::exit(EXIT_FAILURE);
+    }
+    return replaceFilesByArchive;
+}
+
+//finds the FSB each replacement belongs to, and checks that it fits.
+//lists every problem and exits if there are any.
+static std::vector<ModPackTarget> resolveTargets(
+    const std::map<std::string, std::vector<std::string>>& replaceFilesByArchive) {
+
+    //pick an id that none of the archives have temporary files for
+    std::random_device randomDevice {};
+    std::vector<ModPackTarget> targets {};
+    bool pathsTaken { true };
+    while (pathsTaken) {
+        std::ostringstream installId {};
+        installId << ".sm3tools-" << std::hex << (static_cast<std::uint64_t>(
+            std::chrono::system_clock::now().time_since_epoch().count()) ^ randomDevice());
+
+        targets.clear();
+        pathsTaken = false;
+        for (const auto& [archivePath, replaceFilePaths] : replaceFilesByArchive) {
+            targets.push_back({ archivePath,
+                archivePath + installId.str() + std::string { STAGED_SUFFIX },
+                archivePath + installId.str() + std::string { BACKUP_SUFFIX },
+                {} });
+            pathsTaken = pathsTaken || std::filesystem::exists(targets.back().stagedPath)
+                || std::filesystem::exists(targets.back().backupPath);
+        }
+    }
+
+    std::vector<bool> targetHasErrors(targets.size(), false);
+    parallelFor(targets.size(), [&](const std::size_t i) {
+        ModPackTarget& target { targets[i] };
+
+        std::unordered_map<std::string, FSBEntry> entriesByName {};
+        for (const FSBEntry& entry : readFSBEntries(target.archivePath)) {
+            //keep the first FSB with each name, like findFirstFSBMatchingFileName
+            entriesByName.emplace(entry.header.fileName.data(), entry);
+        }
+
+        for (const std::string& replaceFilePath : replaceFilesByArchive.at(target.archivePath)) {
+            const std::string audioFileName { std::filesystem::path { replaceFilePath }.filename().string() };
+            const auto entry { entriesByName.find(audioFileName) };
+            if (entry == entriesByName.end()) {
+                (void) std::fprintf(stderr, "ERROR: %s was not found in %s!\n",
+                    audioFileName.c_str(), target.archivePath.c_str());
+                targetHasErrors[i] = true;
+                continue;
+            }
+            if (static_cast<std::size_t>(MyIO::getfilesize(replaceFilePath.c_str())) > entry->second.header.dataSize) {
+                (void) std::fprintf(stderr, "ERROR: %s has a larger file size than the original audio in %s!\n",
+                    replaceFilePath.c_str(), target.archivePath.c_str());
+                targetHasErrors[i] = true;
+                continue;
+            }
+            target.replacements.push_back({
+                entry->second.headerPosition + FSB_HEADER_SIZE,
+                entry->second.header.dataSize,
+                replaceFilePath });
+        }
+    });
+
+    for (const bool hasErrors : targetHasErrors) {
+        if (hasErrors) {
+            std::cerr << "ERROR: Mod pack can't be installed, no archives were changed.\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    return targets;
+}
+
+//flushes the directory that path is in to disk, so that files created,
+//renamed or deleted in it survive a crash
+static void syncParentDirectory(const std::string& path) {
+    const std::filesystem::path parent { std::filesystem::path { path }.parent_path() };
+    MyIO::syncdirectory(parent.empty() ? "." : parent.string().c_str());
+}
+
+//creates the journal, listing every archive with its backup and staged paths, and
+//flushes it (and its directory) to disk before anything else is written, so that
+//a crash at any later point can be rolled back. returns it open for appendJournal.
+static std::FILE *startJournal(const std::string& journalPath, const std::vector<ModPackTarget>& targets) {
+    std::FILE *const journalHandle { MyIO::fopen(journalPath.c_str(), "w") };
+    for (const ModPackTarget& target : targets) {
+        (void) std::fprintf(journalHandle, "%s\t%s\t%s\t%s\n", JOURNAL_TARGET_TAG.data(),
+            target.archivePath.c_str(), target.backupPath.c_str(), target.stagedPath.c_str());
+    }
+    if (std::ferror(journalHandle)) {
+        std::perror("ERROR: Failed to write mod pack journal");
+        std::exit(EXIT_FAILURE);
+    }
+    MyIO::syncfile(journalHandle);
+    syncParentDirectory(journalPath);
+    return journalHandle;
+}
+
+//records in the journal that the backup of target is complete, so a rollback restores it
+static void appendJournal(std::FILE *const journalHandle, const ModPackTarget& target) {
+    (void) std::fprintf(journalHandle, "%s\t%s\n", JOURNAL_BACKUP_TAG.data(), target.backupPath.c_str());
+    if (std::ferror(journalHandle)) {
+        std::perror("ERROR: Failed to write mod pack journal");
+        std::exit(EXIT_FAILURE);
+    }
+    MyIO::syncfile(journalHandle);
+}
+
+//puts every archive back how it was before the install started: archives whose
+//backup this install made are restored from it, and every other file this install
+//created (which only it can have made, since their names are unique to it) is deleted.
+static void rollBack(const std::vector<ModPackTarget>& targets) {
+    for (const ModPackTarget& target : targets) {
+        std::error_code error {};
+        if (target.backupCreated && std::filesystem::exists(target.backupPath, error)) {
+            std::filesystem::rename(target.backupPath, target.archivePath, error);
+            if (error) {
+                std::cerr << "ERROR: Failed to restore " << target.archivePath << " from "
+                    << target.backupPath << ": " << error.message() << '\n';
+                continue;
+            }
+        }
+        //renaming a hard link over the file it links to leaves both names in place,
+        //and an unrecorded backup may not have been finished, so either way it goes
+        std::filesystem::remove(target.backupPath, error);
+        std::filesystem::remove(target.stagedPath, error);
+    }
+}
+
+//rolls back an install that was interrupted, using the journal it left behind
+static void recoverFromJournal(const std::string& journalPath) {
+    std::ifstream journal { journalPath };
+    std::vector<ModPackTarget> targets {};
+    std::set<std::string> createdBackups {};
+    std::string line {};
+    while (std::getline(journal, line)) {
+        std::vector<std::string> fields {};
+        std::size_t fieldStart { 0 };
+        for (std::size_t tab = line.find('\t'); tab != std::string::npos; tab = line.find('\t', fieldStart)) {
+            fields.push_back(line.substr(fieldStart, tab - fieldStart));
+            fieldStart = tab + 1;
+        }
+        fields.push_back(line.substr(fieldStart));
+
+        if (fields.size() == 4 && fields[0] == JOURNAL_TARGET_TAG) {
+            targets.push_back({ fields[1], fields[3], fields[2], {} });
+        }
+        else if (fields.size() == 2 && fields[0] == JOURNAL_BACKUP_TAG) {
+            createdBackups.insert(fields[1]);
+        }
+    }
+    journal.close();
+
+    for (ModPackTarget& target : targets) {
+        target.backupCreated = createdBackups.count(target.backupPath) != 0;
+    }
+
+    std::cout << "INFO: Rolling back an interrupted mod pack install of "
+        << targets.size() << " archive(s).\n";
+    rollBack(targets);
+    std::filesystem::remove(journalPath);
+    syncParentDirectory(journalPath);
+}
+
+void installModPack(const std::string& manifestPath) {
+    assert(!manifestPath.empty());
+
+    const std::string journalPath { manifestPath + std::string { MODPACK_JOURNAL_EXTENSION } };
+    if (std::filesystem::exists(journalPath)) {
+        recoverFromJournal(journalPath);
+    }
+
+    std::vector<ModPackTarget> targets { resolveTargets(readManifest(manifestPath)) };
+
+    //the journal comes first so that staged files left by a crash while staging are cleaned up too
+    std::FILE *const journalHandle { startJournal(journalPath, targets) };
+
+    //stage every modified archive next to its original, and flush it to disk
+    //so that it can't be renamed over the original before its contents are there
+    parallelFor(targets.size(), [&](const std::size_t i) {
+        copyFile(targets[i].archivePath, targets[i].stagedPath);
+        (void) applyAudioReplacements(targets[i].stagedPath, targets[i].replacements);
+
+        std::FILE *const stagedHandle { MyIO::fopen(targets[i].stagedPath.c_str(), "rb") };
+        MyIO::syncfile(stagedHandle);
+        (void) std::fclose(stagedHandle);
+    });
+    std::cout << "INFO: Staged " << targets.size() << " modified archive(s), committing.\n";
+
+    std::set<std::string> archiveDirectories {};
+    try {
+        for (ModPackTarget& target : targets) {
+            //the backup is a hard link so the original never stops existing,
+            //and the rename of the staged file over it is atomic
+            std::error_code linkError {};
+            std::filesystem::create_hard_link(target.archivePath, target.backupPath, linkError);
+            if (linkError) {
+                copyFile(target.archivePath, target.backupPath);
+            }
+            syncParentDirectory(target.backupPath);
+            //only recorded once it is complete, a backup that isn't recorded is never restored
+            target.backupCreated = true;
+            appendJournal(journalHandle, target);
+
+            std::filesystem::rename(target.stagedPath, target.archivePath);
+            archiveDirectories.insert(std::filesystem::path { target.archivePath }.parent_path().string());
+        }
+    }
+    catch (const std::filesystem::filesystem_error& error) {
+        std::cerr << "ERROR: Failed to commit mod pack (" << error.what() << "), rolling back.\n";
+        (void) std::fclose(journalHandle);
+        rollBack(targets);
+        std::filesystem::remove(journalPath);
+        std::exit(EXIT_FAILURE);
+    }
+    (void) std::fclose(journalHandle);
+
+    //the renames have to be on disk before the journal that could undo them is removed
+    for (const std::string& directory : archiveDirectories) {
+        MyIO::syncdirectory(directory.c_str());
+    }
+
+    //everything is committed, so the backups aren't needed anymore
+    std::filesystem::remove(journalPath);
+    syncParentDirectory(journalPath);
+    for (const ModPackTarget& target : targets) {
+        std::error_code error {};
+        std::filesystem::remove(target.backupPath, error);
+    }
+    std::cout << "INFO: Installed mod pack into " << targets.size() << " archive(s).\n";
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MODPACK_H
+#define MODPACK_H
+#include <string>
+#include <string_view>
+
+//A mod pack manifest is a text file listing audio files to inject into PCSSBs,
+//one per line, as the path of the PCSSB and the path of the audio file separated by a tab:
+//    sound/spidey.pcssb	replacements/spidey_grunt_03.wav
+//Empty lines and lines starting with '#' are ignored. Relative paths are relative
+//to the directory the manifest is in. Audio files are matched to FSBs by name,
+//the same as in replace mode.
+
+//extension of the journal kept next to the manifest while archives are being replaced
+constexpr std::string_view MODPACK_JOURNAL_EXTENSION { ".journal" };
+
+//installs every replacement listed in the manifest at manifestPath as one transaction.
+//all archives and replacements are checked before anything is written, then every
+//modified archive is written to a temporary file in parallel, and finally all
+//of the temporary files are renamed over the originals together. If any rename fails,
+//the archives that were already replaced are restored from their backups.
+//The temporary and backup files have names unique to the install, so existing files
+//are never touched. A journal of them (flushed to disk before anything else is
+//written, and after each backup is made) is kept so that an install that was
+//interrupted part way through is rolled back the next time this is run with the same manifest.
+//logs the error and exits if the install can't be done, leaving the archives unchanged.
+void installModPack(const std::string& manifestPath);
+
+#endif
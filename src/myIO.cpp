@@ -30,9 +30,20 @@
 
 #ifdef _WIN32
 #include <direct.h>
+#include <io.h>
+#include <fcntl.h>
 #endif
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
 
 namespace MyIO {
     void mkdir(const char *const path) {
@@ -87,6 +98,16 @@ namespace MyIO {
         return fileHandle;
     }
 
+    std::FILE *openstdin() {
+#ifdef _WIN32
+        if (::_setmode(::_fileno(stdin), _O_BINARY) == -1) {
+            std::perror("ERROR: Failed to set standard input to binary mode");
+            std::exit(EXIT_FAILURE);
+        }
+#endif
+        return stdin;
+    }
+
     std::size_t fread(
         void *const buffer,
         const std::size_t size,
@@ -173,4 +194,245 @@ namespace MyIO {
             MyIO::fseek(stream, static_cast<long int>(offset), origin);
         }
     }
+
+    void syncfile(std::FILE *const stream) {
+        assert(stream != nullptr);
+
+        if (std::fflush(stream) != 0) {
+            std::perror("ERROR: Failed to flush file");
+            std::exit(EXIT_FAILURE);
+        }
+#ifdef _WIN32
+        const int returnValue { ::_commit(::_fileno(stream)) };
+#else
+        const int returnValue { ::fsync(::fileno(stream)) };
+#endif
+        if (returnValue != 0) {
+            std::perror("ERROR: Failed to flush file to disk");
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    void syncdirectory(const char *const path) {
+        assert(path != nullptr);
+
+#ifndef _WIN32
+        const int fd { ::open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC) };
+        if (fd < 0) {
+            std::perror("ERROR: Failed to open directory");
+            std::exit(EXIT_FAILURE);
+        }
+        if (::fsync(fd) != 0) {
+            std::perror("ERROR: Failed to flush directory to disk");
+            std::exit(EXIT_FAILURE);
+        }
+        (void) ::close(fd);
+#endif
+    }
+
+    FileView mapfile(const char *const path) {
+        assert(path != nullptr);
+
+        FileView view {};
+        view.size = static_cast<std::size_t>(MyIO::getfilesize(path));
+        if (view.size == 0) {
+            //zero length mappings aren't allowed, and there's nothing to read anyway
+            return view;
+        }
+
+#ifdef _WIN32
+        unsigned char *const buffer { new unsigned char[view.size] };
+        std::FILE *const fileHandle { MyIO::fopen(path, "rb") };
+        {
+            const std::size_t numRead { MyIO::fread(buffer, sizeof(char), view.size, fileHandle) };
+            view.size = numRead;
+        }
+        (void) std::fclose(fileHandle);
+        view.data = buffer;
+        view.mapped = false;
+#else
+        const int fd { ::open(path, O_RDONLY) };
+        if (fd < 0) {
+            std::perror("ERROR: Failed to open file");
+            std::exit(EXIT_FAILURE);
+        }
+        void *const mapping { ::mmap(nullptr, view.size, PROT_READ, MAP_PRIVATE, fd, 0) };
+        //the mapping stays valid after the descriptor is closed
+        (void) ::close(fd);
+        if (mapping == MAP_FAILED) {
+            std::perror("ERROR: Failed to map file");
+            std::exit(EXIT_FAILURE);
+        }
+        view.data = static_cast<const unsigned char *>(mapping);
+        view.mapped = true;
+#endif
+        return view;
+    }
+
+    void unmapfile(FileView& view) {
+        if (view.data != nullptr) {
+#ifdef _WIN32
+            delete[] view.data;
+#else
+            if (view.mapped) {
+                (void) ::munmap(const_cast<unsigned char *>(view.data), view.size);
+            }
+            else {
+                delete[] view.data;
+            }
+#endif
+        }
+        view = FileView {};
+    }
+
+    bool clonefile(const char *const source, const char *const destination) {
+        assert(source != nullptr);
+        assert(destination != nullptr);
+
+#ifdef __linux__
+        const int sourceFd { ::open(source, O_RDONLY) };
+        if (sourceFd < 0) {
+            std::perror("ERROR: Failed to open file");
+            std::exit(EXIT_FAILURE);
+        }
+        struct stat sb {};
+        if (::fstat(sourceFd, &sb) != 0) {
+            std::perror("ERROR: Failed to get file size");
+            std::exit(EXIT_FAILURE);
+        }
+        const int destinationFd { ::open(destination, O_WRONLY | O_CREAT | O_TRUNC, sb.st_mode & 0777) };
+        if (destinationFd < 0) {
+            std::perror("ERROR: Failed to open file");
+            std::exit(EXIT_FAILURE);
+        }
+
+        bool copied { false };
+#ifdef FICLONE
+        copied = ::ioctl(destinationFd, FICLONE, sourceFd) == 0;
+#endif
+        if (!copied) {
+            //copy_file_range still avoids copying through user space, and some
+            //filesystems (e.g. NFS, XFS) turn it into a reflink by themselves
+            auto remaining { static_cast<std::size_t>(sb.st_size) };
+            copied = true;
+            while (remaining > 0) {
+                const ssize_t numCopied { ::copy_file_range(sourceFd, nullptr, destinationFd, nullptr, remaining, 0) };
+                if (numCopied <= 0) {
+                    copied = false;
+                    break;
+                }
+                remaining -= static_cast<std::size_t>(numCopied);
+            }
+            if (!copied) {
+                //leave the destination empty for the caller's own copy
+                (void) ::ftruncate(destinationFd, 0);
+            }
+        }
+
+        (void) ::close(destinationFd);
+        (void) ::close(sourceFd);
+        return copied;
+#else
+        return false;
+#endif
+    }
+
+    OutputDirectory opendirectory(const char *const path, const bool durable) {
+        assert(path != nullptr);
+
+        OutputDirectory directory {};
+        directory.path = path;
+        directory.durable = durable;
+#ifndef _WIN32
+        directory.fd = ::open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (directory.fd < 0) {
+            std::perror("ERROR: Failed to open directory");
+            std::exit(EXIT_FAILURE);
+        }
+#endif
+        return directory;
+    }
+
+#ifndef _WIN32
+    //flushes every file in unsyncedFds to disk and closes them
+    static void syncfiles(OutputDirectory& directory) {
+        for (const int fd : directory.unsyncedFds) {
+            if (::fsync(fd) != 0) {
+                std::perror("ERROR: Failed to flush file to disk");
+                std::exit(EXIT_FAILURE);
+            }
+            (void) ::close(fd);
+        }
+        directory.unsyncedFds.clear();
+    }
+#endif
+
+    void writefileat(
+        OutputDirectory& directory,
+        const char *const fileName,
+        const void *const data,
+        const std::size_t size) {
+
+        assert(fileName != nullptr);
+        assert(data != nullptr || size == 0);
+
+#ifdef _WIN32
+        const std::string filePath { directory.path + "/" + fileName };
+        std::FILE *const fileHandle { MyIO::fopen(filePath.c_str(), "wb") };
+        if (size > 0) {
+            (void) MyIO::fwrite(data, sizeof(char), size, fileHandle);
+        }
+        if (directory.durable) {
+            (void) std::fflush(fileHandle);
+        }
+        (void) std::fclose(fileHandle);
+#else
+        assert(directory.fd >= 0);
+
+        const int fd { ::openat(directory.fd, fileName, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666) };
+        if (fd < 0) {
+            std::perror("ERROR: Failed to open file");
+            std::exit(EXIT_FAILURE);
+        }
+
+        //normally done in a single call, but pwrite is allowed to write less than asked
+        std::size_t numWritten { 0 };
+        while (numWritten < size) {
+            const ssize_t result { ::pwrite(fd, static_cast<const char *>(data) + numWritten,
+                size - numWritten, static_cast<off_t>(numWritten)) };
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                std::perror("ERROR: I/O error when writing");
+                std::exit(EXIT_FAILURE);
+            }
+            numWritten += static_cast<std::size_t>(result);
+        }
+
+        if (directory.durable) {
+            directory.unsyncedFds.push_back(fd);
+            if (directory.unsyncedFds.size() >= OUTPUT_DIRECTORY_SYNC_BATCH) {
+                syncfiles(directory);
+            }
+        }
+        else {
+            (void) ::close(fd);
+        }
+#endif
+    }
+
+    void closedirectory(OutputDirectory& directory) {
+#ifndef _WIN32
+        if (directory.fd >= 0) {
+            if (directory.durable) {
+                syncfiles(directory);
+                //makes the new directory entries themselves durable
+                (void) ::fsync(directory.fd);
+            }
+            (void) ::close(directory.fd);
+        }
+#endif
+        directory = OutputDirectory {};
+    }
 }
@@ -21,6 +21,8 @@
 #define MYIO_H
 #include <cstdint>
 #include <cstdio>
+#include <string>
+#include <vector>
 
 namespace MyIO {
     //cross-platform mkdir wrapper.
@@ -41,6 +43,10 @@ namespace MyIO {
     //after you're done using it, like with normal fopen.
     std::FILE *fopen(const char *fileName, const char *mode);
 
+    //returns stdin, switched to binary mode on platforms that translate
+    //line endings in text mode (Windows).
+    std::FILE *openstdin();
+
     //wrapper around fread that checks feof and ferror
     //after doing so. Prints to the terminal if any of those happen, and exits
     //in the case of ferror. The number of objects read is checked to see whether
@@ -71,5 +77,71 @@ namespace MyIO {
     //signed longs support by seeking twice.
     //if first fseek fails second isn't executed.
     void fseekunsigned(std::FILE *stream, unsigned long int offset, int origin);
+
+    //flushes stream's buffer and then the file itself to disk (fsync),
+    //so what was written survives a crash. logs the error and exits if it fails.
+    void syncfile(std::FILE *stream);
+
+    //flushes the entries of the directory at path to disk, so that files
+    //created, renamed or deleted in it survive a crash. does nothing on Windows,
+    //where directories can't be flushed. logs the error and exits if it fails.
+    void syncdirectory(const char *path);
+
+    //read-only view of the entire contents of a file.
+    //mapped is true if the memory is a memory mapping of the file rather
+    //than a heap allocated copy of it.
+    struct FileView {
+        const unsigned char *data { nullptr };
+        std::size_t size { 0 };
+        bool mapped { false };
+    };
+
+    //maps the entire file at path into memory as read-only.
+    //on platforms without mmap the file is read into a heap buffer instead.
+    //logs the error and exits if the file can't be opened or mapped.
+    //NOTE: the view has to be released with unmapfile after you're done using it.
+    FileView mapfile(const char *path);
+
+    //releases the memory of a view returned by mapfile and resets it to be empty.
+    void unmapfile(FileView& view);
+
+    //makes destination (creating or truncating it) an exact copy of source without
+    //passing the data through user space. on filesystems that support reflinks
+    //(e.g. btrfs, XFS) the copy shares the source's extents (FICLONE), otherwise
+    //copy_file_range is used. logs the error and exits if source can't be opened.
+    //returns false if neither is supported on this platform or filesystem, in which
+    //case the caller has to copy the data itself.
+    bool clonefile(const char *source, const char *destination);
+
+    //a directory that many small files are written into.
+    //on POSIX systems the directory is opened once and files are created relative
+    //to it, so the full path doesn't have to be resolved again for every file.
+    struct OutputDirectory {
+        std::string path {};
+        int fd { -1 };
+        //whether written files have to be flushed to disk before closedirectory returns
+        bool durable { false };
+        //files that have been written but not yet flushed to disk (durable only)
+        std::vector<int> unsyncedFds {};
+    };
+
+    //number of written files that are kept open waiting to be flushed together
+    //when an OutputDirectory is durable
+    constexpr std::size_t OUTPUT_DIRECTORY_SYNC_BATCH { 64 };
+
+    //opens the existing directory at path for writing files into.
+    //logs the error and exits if it can't be opened.
+    //NOTE: has to be closed with closedirectory after you're done using it.
+    OutputDirectory opendirectory(const char *path, bool durable);
+
+    //creates (or truncates) fileName inside the directory and writes size bytes of
+    //data to it with as few system calls as possible, without stdio buffering.
+    //if the directory is durable, flushing to disk is deferred and done in batches.
+    //logs the error and exits if the file can't be written.
+    void writefileat(OutputDirectory& directory, const char *fileName, const void *data, std::size_t size);
+
+    //flushes any files that are still waiting (and the directory itself) to disk
+    //if the directory is durable, then closes it.
+    void closedirectory(OutputDirectory& directory);
 }
 #endif
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+
+//number of worker threads to use for parallel work.
+//never returns less than 1.
+inline std::size_t workerCount() {
+    const unsigned int hardwareThreads { std::thread::hardware_concurrency() };
+    return hardwareThreads == 0 ? 1 : hardwareThreads;
+}
+
+//calls func(i) for every i in [0, count) spread across worker threads.
+//items are handed out one at a time so uneven work still gets balanced.
+//func must be safe to call concurrently from different threads.
+//returns once every item has been processed.
+template <typename Func>
+void parallelFor(const std::size_t count, Func&& func) {
+    const std::size_t numThreads { std::min(workerCount(), count) };
+    if (numThreads <= 1) {
+        for (std::size_t i = 0; i < count; i++) {
+            func(i);
+        }
+        return;
+    }
+
+    std::atomic<std::size_t> nextIndex { 0 };
+    const auto worker = [&]() {
+        for (std::size_t i = nextIndex++; i < count; i = nextIndex++) {
+            func(i);
+        }
+    };
+
+    std::vector<std::thread> threads {};
+    threads.reserve(numThreads - 1);
+    for (std::size_t t = 1; t < numThreads; t++) {
+        threads.emplace_back(worker);
+    }
+    //the calling thread does its share of the work too
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+#endif
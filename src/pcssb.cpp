@@ -22,6 +22,11 @@
 #include <iostream>
 #include <filesystem>
 #include <array>
+#include <algorithm>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include <cassert>
 #include <cstdio>
@@ -29,78 +34,150 @@
 #include <cstring>
 
 #include "myIO.hpp"
+#include "bytes.hpp"
+#include "parallel.hpp"
+#include "wav.hpp"
+#include "bundle.hpp"
+#include "analysis.hpp"
+#include "archiveengine.hpp"
+
+bool isValidFSBHeader(const FSBHeader& header) {
+    constexpr std::uint32_t SAMPLE_HEADER_SIZE { FSB_HEADER_SIZE - FSBField::ENTRY_SIZE };
+    return header.numSamples == 1
+        && header.sampleHeadersSize == SAMPLE_HEADER_SIZE
+        && header.entrySize == SAMPLE_HEADER_SIZE;
+}
 
-std::vector<size_t> findFSBIndexes(const std::string& filePath) {
-    assert(!filePath.empty());
+std::vector<FSBEntry> readFSBEntries(const std::string& filePath) {
+    std::vector<FSBEntry> entries {};
+    forEachArchiveEntry<PCSSBFormat>(filePath, [&entries](const FSBEntry& entry) {
+        entries.push_back(entry);
+        return true;
+    });
+    return entries;
+}
 
-    std::vector<size_t> fsbIndexes {};
-    //PCSSBs can have a lot more FSBs than this (though seldom more than 50),
-    //but this expands in a way that should minimise the number of reallocations
-    fsbIndexes.reserve(12);
+std::vector<std::string> findPCSSBFiles(const std::string& directory) {
+    assert(!directory.empty());
 
-    const auto fileSize = static_cast<size_t>(MyIO::getfilesize(filePath.c_str()));
-    char *const buffer = new char[fileSize];
-    {
-        //NOTE: we assume that result of getfilesize is the actual file size
-        std::FILE *const fileHandle { MyIO::fopen(filePath.c_str(), "rb") };
-        {
-            //read entire file into buffer
-            const std::size_t numRead = MyIO::fread(
-                buffer,
-                sizeof(char),
-                fileSize,
-                fileHandle);
-            assert(numRead == fileSize);
-
-            //build a string view with length added in for safety
-            const std::string_view bufferSV { buffer, numRead };
-            assert(bufferSV.size() == fileSize);
-
-            //search from start of the file
-            size_t searchStartPos = 0;
-            bool isFullySearched { false };
-            while (!isFullySearched) {
-                assert(searchStartPos < bufferSV.size());
-                //look for next occurrence of "FSB3" substring
-                const size_t fsbIndex = bufferSV.find(FSB_MAGIC_STRING, searchStartPos);
-                assert(fsbIndex >= searchStartPos);
-                //if an occurrence of the substring was found
-                if (fsbIndex != std::string_view::npos) {
-                    fsbIndexes.push_back(fsbIndex);
-                    //move the start index for the next search to after the found occurrence
-                    searchStartPos = fsbIndex + FSB_MAGIC_STRING.length();
-                }
-                else {
-                    isFullySearched = true;
-                }
-            }
+    std::vector<std::string> filePaths {};
+    for (const auto& dirEntry : std::filesystem::recursive_directory_iterator(directory)) {
+        // FIXME case sensitive currently, same as getFileType
+        if (dirEntry.is_regular_file() && dirEntry.path().extension() == ".pcssb") {
+            filePaths.push_back(dirEntry.path().string());
         }
-        (void) std::fclose(fileHandle);
     }
-    delete[] buffer;
-    return fsbIndexes;
+    std::sort(filePaths.begin(), filePaths.end());
+    return filePaths;
+}
+
+//prints the line describing one FSB in a listing
+static void printFSBEntry(const std::size_t number, const FSBEntry& entry) {
+    const FSBHeader& header { entry.header };
+    //NOTE: casts to unsigned long avoid needing to import <inttypes.h>
+    //for the PRIu32 format specifiers
+    std::printf("%zu: "
+                "Offset (hexadecimal) = 0x%zX, "
+                "FSB File Name %s, "
+                "FSB Data Size = %lu, "
+                "Sample Rate = %lu, "
+                "Channels = %u, "
+                "Mode = 0x%lX, "
+                "Loop = %lu-%lu \n",
+                number,
+                entry.headerPosition,
+                header.fileName.data(),
+                static_cast<unsigned long>(header.dataSize),
+                static_cast<unsigned long>(header.frequency),
+                static_cast<unsigned>(header.numChannels),
+                static_cast<unsigned long>(header.mode),
+                static_cast<unsigned long>(header.loopStart),
+                static_cast<unsigned long>(header.loopEnd));
 }
 
 void printFSBList(const std::string& filePath) {
     assert(!filePath.empty());
 
-    const std::vector<size_t> indexes { findFSBIndexes(filePath) };
-    for (std::size_t i = 0; i < indexes.size(); i += 2) {
-        if (i < indexes.size() - 2) {
-            const std::string fsbFileName = readFileName(filePath, indexes.at(i));
-            std::printf("%zu: "
-                        "Offset (hexadecimal) = 0x%zX, "
-                        "FSB File Name %s, "
-                        "FSB Data Size = %lu \n",
-                        i+1,
-                        indexes.at(i),
-                        fsbFileName.c_str(),
-                        //avoids needing to import <inttypes.h> for the PRIu64 format specifier
-                        static_cast<unsigned long>(readDataSize(filePath, indexes.at(i))));
-        }
+    const std::vector<FSBEntry> entries { readFSBEntries(filePath) };
+    for (std::size_t i = 0; i < entries.size(); i++) {
+        printFSBEntry(i+1, entries[i]);
     }
 }
 
+void printFSBList(std::FILE *const inputStream) {
+    std::size_t number { 0 };
+    forEachFSBEntryInStream(inputStream, [&number](const FSBEntry& entry, const unsigned char *, std::size_t) {
+        printFSBEntry(++number, entry);
+        return true;
+    });
+}
+
+FSBHeader decodeFSBHeader(const unsigned char *const bytes) {
+    assert(bytes != nullptr);
+    assert(std::memcmp(bytes + FSBField::MAGIC, FSB_MAGIC_STRING.data(), FSB_MAGIC_STRING.size()) == 0);
+
+    FSBHeader header {};
+    header.numSamples = readLittleEndian<std::uint32_t>(bytes, FSBField::NUM_SAMPLES);
+    header.sampleHeadersSize = readLittleEndian<std::uint32_t>(bytes, FSBField::SAMPLE_HEADERS_SIZE);
+    header.dataSize = readLittleEndian<std::uint32_t>(bytes, FSBField::DATA_SIZE);
+    header.version = readLittleEndian<std::uint32_t>(bytes, FSBField::VERSION);
+    header.archiveMode = readLittleEndian<std::uint32_t>(bytes, FSBField::ARCHIVE_MODE);
+
+    header.entrySize = readLittleEndian<std::uint16_t>(bytes, FSBField::ENTRY_SIZE);
+    //NOTE: the last byte of fileName is left as the null terminator
+    //for the case that the file name is 30 bytes long.
+    std::memcpy(header.fileName.data(), bytes + FSBField::FILENAME, FSB_FILENAME_SIZE);
+
+    header.lengthSamples = readLittleEndian<std::uint32_t>(bytes, FSBField::LENGTH_SAMPLES);
+    header.lengthCompressed = readLittleEndian<std::uint32_t>(bytes, FSBField::LENGTH_COMPRESSED);
+    header.loopStart = readLittleEndian<std::uint32_t>(bytes, FSBField::LOOP_START);
+    header.loopEnd = readLittleEndian<std::uint32_t>(bytes, FSBField::LOOP_END);
+    header.mode = readLittleEndian<std::uint32_t>(bytes, FSBField::MODE);
+    header.frequency = readLittleEndian<std::uint32_t>(bytes, FSBField::FREQUENCY);
+    header.defaultVolume = readLittleEndian<std::uint16_t>(bytes, FSBField::DEFAULT_VOLUME);
+    header.defaultPan = readLittleEndian<std::uint16_t>(bytes, FSBField::DEFAULT_PAN);
+    header.defaultPriority = readLittleEndian<std::uint16_t>(bytes, FSBField::DEFAULT_PRIORITY);
+    header.numChannels = readLittleEndian<std::uint16_t>(bytes, FSBField::NUM_CHANNELS);
+    header.minDistance = readLittleEndianFloat(bytes, FSBField::MIN_DISTANCE);
+    header.maxDistance = readLittleEndianFloat(bytes, FSBField::MAX_DISTANCE);
+    header.variationFrequency = readLittleEndian<std::uint32_t>(bytes, FSBField::VARIATION_FREQUENCY);
+    header.variationVolume = readLittleEndian<std::uint16_t>(bytes, FSBField::VARIATION_VOLUME);
+    header.variationPan = readLittleEndian<std::uint16_t>(bytes, FSBField::VARIATION_PAN);
+
+    return header;
+}
+
+FSBHeader readFSBHeader(std::FILE *const fileHandle, const std::size_t fsb3HeaderPosition) {
+    assert(fileHandle != nullptr);
+
+    std::array<unsigned char, FSB_HEADER_SIZE> buffer {};
+
+    //set the file position indicator to start of FSB file
+    MyIO::fseekunsigned(fileHandle, fsb3HeaderPosition, SEEK_SET);
+    //read the whole header in one go
+    const std::size_t numRead { MyIO::fread(buffer.data(), sizeof(char), buffer.size(), fileHandle) };
+    if (numRead != buffer.size()) {
+        (void) std::fprintf(stderr, "ERROR: FSB header at position %zu is truncated!\n", fsb3HeaderPosition);
+        (void) std::fclose(fileHandle);
+        std::exit(EXIT_FAILURE);
+    }
+
+    return decodeFSBHeader(buffer.data());
+}
+
+FSBHeader readFSBHeader(
+    const std::string& inputFileName,
+    const std::size_t fsb3HeaderPosition) {
+
+    assert(!inputFileName.empty());
+
+    std::FILE *const fileHandle { MyIO::fopen(inputFileName.c_str(), "rb") };
+    const FSBHeader header { readFSBHeader(fileHandle, fsb3HeaderPosition) };
+    (void) std::fclose(fileHandle);
+
+    return header;
+}
+
 std::uint32_t readDataSize(
     const std::string& inputFileName,
     const std::size_t fsb3HeaderPosition) {
@@ -117,7 +194,9 @@ std::uint32_t readDataSize(
         MyIO::fseek(fileHandle, DATA_SIZE_OFFSET, SEEK_CUR);
 
         //read data size long
-        (void) MyIO::fread(&dataSize, sizeof(uint32_t), 1, fileHandle);
+        std::array<unsigned char, sizeof(std::uint32_t)> bytes {};
+        (void) MyIO::fread(bytes.data(), sizeof(char), bytes.size(), fileHandle);
+        dataSize = readLittleEndian<std::uint32_t>(bytes.data(), 0);
     }
     (void) std::fclose(fileHandle);
 
@@ -188,10 +267,284 @@ void outputAudioData(
     delete[] audioData;
 }
 
-void outputAudioFiles(const std::string& inputFileName, const std::string_view outputDirectory) {
+//an FSB waiting to have its audio read (and converted), numbered in the order it was found
+struct DecodeJob {
+    std::size_t number {};
+    FSBEntry entry {};
+};
+
+//size the audio of an FSB is read, converted and written in by the extraction pipeline.
+//one piece of a WAV file can be a little larger, as the last block converted can go past it
+constexpr std::size_t EXTRACT_CHUNK_SIZE { 256 * 1024 };
+
+//a piece of an output file waiting to be written, numbered the same as the DecodeJob it came from.
+//the pieces of a file come one after another from the same decode thread, so they arrive in order
+struct WriteJob {
+    std::size_t number {};
+    std::string fileName {};
+    std::vector<unsigned char> data {};
+    bool isFirst {};
+    bool isLast {};
+};
+
+//extracts the FSBs given by source from inputFileName into files in outputDirectoryPath.
+//source is called once with a callback, which it calls with each FSB that should be extracted
+//(stopping early if that returns false). both are template parameters rather than
+//std::function, so the callback can be inlined into the walk over the archive.
+//three stages run at the same time, connected by BoundedQueues: source runs on the calling
+//thread, decode threads read the audio of each FSB (converting and analysing it if needed)
+//with their own handle to the input, and write threads write the finished files out.
+//so the first files are written while the rest of the archive is still being scanned,
+//and the queues stop any stage from getting far ahead of the ones after it.
+//the audio goes through in pieces of about EXTRACT_CHUNK_SIZE bytes rather than whole FSBs,
+//so about (queue depth + decode threads + write threads) pieces are in memory at once,
+//however large the FSBs are. a file of more than one piece is written under a temporary
+//name and renamed once it's complete.
+//each write thread has its own queue, and a file name always goes to the same one, so two
+//FSBs with the same name are never written at once. like extracting them one at a time,
+//the last of them in the archive is the one that ends up in the file.
+template <typename EntrySource>
+static void runExtractionPipeline(
+    const std::string& inputFileName,
+    const std::filesystem::path& outputDirectoryPath,
+    const OutputFormat format,
+    const bool durable,
+    const PipelineConfig& config,
+    const EntrySource& source,
+    std::vector<AudioAnalysis> *const analyses) {
+
+    assert(format != OutputFormat::bundle);
+
+    const std::size_t decodeThreads { config.decodeThreads == 0 ? workerCount() : config.decodeThreads };
+    const std::size_t writeThreads { std::max<std::size_t>(config.writeThreads, 1) };
+    //the data sizes in headers can't be trusted, so reads are kept within the file
+    const auto fileSize { static_cast<std::size_t>(MyIO::getfilesize(inputFileName.c_str())) };
+
+    BoundedQueue<DecodeJob> decodeQueue {};
+    decodeQueue.capacity = std::max<std::size_t>(config.queueDepth, 1);
+    //the queue depth is shared between the write queues
+    std::vector<BoundedQueue<WriteJob>> writeQueues(writeThreads);
+    for (BoundedQueue<WriteJob>& writeQueue : writeQueues) {
+        writeQueue.capacity = std::max<std::size_t>(decodeQueue.capacity / writeThreads, 1);
+    }
+
+    //finished out of order by the decode threads, so they're numbered and sorted at the end
+    std::mutex analysesMutex {};
+    std::vector<std::pair<std::size_t, AudioAnalysis>> numberedAnalyses {};
+
+    std::vector<std::thread> writers { startStage(writeThreads, [&](const std::size_t writer) {
+        //each writer has its own handle to the directory, so the durable flushes aren't shared
+        MyIO::OutputDirectory directory { MyIO::opendirectory(outputDirectoryPath.string().c_str(), durable) };
+        //number of the FSB last written to each file. decoding finishes out of order, so an
+        //earlier FSB with the same name can be finished after a later one and has to be dropped
+        std::unordered_map<std::string, std::size_t> writtenNumbers {};
+        const auto isLatest { [&writtenNumbers](const WriteJob& job) {
+            const auto [written, isFirst] { writtenNumbers.try_emplace(job.fileName, job.number) };
+            if (!isFirst) {
+                if (written->second > job.number) {
+                    return false;
+                }
+                written->second = job.number;
+            }
+            return true;
+        } };
+        //files with more than one piece that are still being written, by FSB number
+        std::unordered_map<std::size_t, std::FILE *> partFiles {};
+
+        WriteJob job {};
+        while (popQueue(writeQueues[writer], job)) {
+            if (job.isFirst && job.isLast) {
+                if (isLatest(job)) {
+                    MyIO::writefileat(directory, job.fileName.c_str(), job.data.data(), job.data.size());
+                }
+                continue;
+            }
+
+            const std::filesystem::path partPath { outputDirectoryPath
+                / (job.fileName + ".sm3tools-part-" + std::to_string(job.number)) };
+            if (job.isFirst) {
+                partFiles[job.number] = MyIO::fopen(partPath.string().c_str(), "wb");
+            }
+            std::FILE *const partFileHandle { partFiles.at(job.number) };
+            if (!job.data.empty()) {
+                (void) MyIO::fwrite(job.data.data(), sizeof(char), job.data.size(), partFileHandle);
+            }
+            if (job.isLast) {
+                if (durable) {
+                    MyIO::syncfile(partFileHandle);
+                }
+                (void) std::fclose(partFileHandle);
+                partFiles.erase(job.number);
+                if (isLatest(job)) {
+                    std::filesystem::rename(partPath, outputDirectoryPath / job.fileName);
+                }
+                else {
+                    std::filesystem::remove(partPath);
+                }
+            }
+        }
+        //the renames are made durable along with the directory
+        MyIO::closedirectory(directory);
+    }) };
+
+    std::vector<std::thread> decoders { startStage(decodeThreads, [&](std::size_t) {
+        std::FILE *const inputFileHandle { MyIO::fopen(inputFileName.c_str(), "rb") };
+        {
+            DecodeJob job {};
+            while (popQueue(decodeQueue, job)) {
+                const FSBEntry& entry { job.entry };
+                if (!entry.dataSizeMatches) {
+                    std::cout << "LOG: Data size value doesn't match actual size!\n";
+                }
+                const std::size_t dataPosition { std::min(entry.headerPosition + FSB_HEADER_SIZE, fileSize) };
+                const std::size_t dataSize { std::min<std::size_t>(entry.header.dataSize, fileSize - dataPosition) };
+                MyIO::fseekunsigned(inputFileHandle, dataPosition, SEEK_SET);
+
+                const bool convertsToWav { format == OutputFormat::wav && isWavConvertible(entry.header) };
+                std::string fileName { entry.header.fileName.data() };
+                if (convertsToWav) {
+                    fileName = std::filesystem::path { fileName }.replace_extension(".wav").string();
+                }
+                const std::size_t writer { std::hash<std::string> {}(fileName) % writeThreads };
+
+                //the piece of the file being filled, sent to the writer once it is EXTRACT_CHUNK_SIZE bytes
+                WriteJob piece { job.number, fileName, {}, true, false };
+                const auto sendPiece { [&](const bool isLast) {
+                    piece.isLast = isLast;
+                    WriteJob nextPiece { job.number, fileName, {}, false, false };
+                    pushQueue(writeQueues[writer], std::move(piece));
+                    piece = std::move(nextPiece);
+                } };
+
+                AudioAnalysis analysis {};
+                if (convertsToWav) {
+                    convertWavFile(entry.header, inputFileHandle, dataSize,
+                        [&](const unsigned char *const data, const std::size_t count) {
+                            piece.data.insert(piece.data.end(), data, data + count);
+                            if (piece.data.size() >= EXTRACT_CHUNK_SIZE) {
+                                sendPiece(false);
+                            }
+                        }, analyses != nullptr ? &analysis : nullptr);
+                }
+                else {
+                    if (format == OutputFormat::wav) {
+                        std::cout << "LOG: " << entry.header.fileName.data()
+                            << " is not PCM or IMA ADPCM, writing it without converting.\n";
+                    }
+                    AudioAnalyser analyser { startAnalysis(entry.header) };
+                    std::size_t remaining { dataSize };
+                    while (remaining > 0) {
+                        piece.data.resize(std::min(remaining, EXTRACT_CHUNK_SIZE));
+                        const std::size_t numRead { MyIO::fread(piece.data.data(), sizeof(char), piece.data.size(), inputFileHandle) };
+                        piece.data.resize(numRead);
+                        if (analyses != nullptr) {
+                            analyseChunk(analyser, piece.data.data(), numRead);
+                        }
+                        //the file size was checked, but it could still have been cut short since
+                        remaining = numRead == 0 ? 0 : remaining - numRead;
+                        if (remaining > 0) {
+                            sendPiece(false);
+                        }
+                    }
+                    analysis = finishAnalysis(analyser);
+                }
+                sendPiece(true);
+
+                if (analyses != nullptr) {
+                    const std::lock_guard<std::mutex> lock { analysesMutex };
+                    numberedAnalyses.emplace_back(job.number, std::move(analysis));
+                }
+            }
+        }
+        (void) std::fclose(inputFileHandle);
+    }) };
+
+    std::size_t number { 0 };
+    source([&](const FSBEntry& entry) {
+        pushQueue(decodeQueue, DecodeJob { number++, entry });
+        return true;
+    });
+    closeQueue(decodeQueue);
+    joinStage(decoders);
+    for (BoundedQueue<WriteJob>& writeQueue : writeQueues) {
+        closeQueue(writeQueue);
+    }
+    joinStage(writers);
+
+    if (analyses != nullptr) {
+        std::sort(numberedAnalyses.begin(), numberedAnalyses.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.first < rhs.first;
+        });
+        analyses->clear();
+        analyses->reserve(numberedAnalyses.size());
+        for (auto& numberedAnalysis : numberedAnalyses) {
+            analyses->push_back(std::move(numberedAnalysis.second));
+        }
+    }
+}
+
+void outputAudioFiles(
+    const std::string& inputFileName,
+    const std::string_view outputDirectory,
+    const OutputFormat format,
+    const bool durable,
+    const NameFilter& filter,
+    std::vector<AudioAnalysis> *const analyses,
+    const PipelineConfig& pipeline) {
+
+    assert(!inputFileName.empty());
+
+    if (format == OutputFormat::bundle) {
+        //the bundle's index is written before its data, so every entry has to be known first
+        std::vector<FSBEntry> entries { readFSBEntries(inputFileName) };
+        if (!selectsEverything(filter)) {
+            const std::size_t entryCount { entries.size() };
+            entries.erase(std::remove_if(entries.begin(), entries.end(), [&filter](const FSBEntry& entry) {
+                return !matchesNameFilter(filter, entry.header.fileName.data());
+            }), entries.end());
+            std::cout << "INFO: " << entries.size() << " of " << entryCount << " FSBs matched the filters.\n";
+        }
+        outputAudioFiles(inputFileName, entries, outputDirectory, format, durable, analyses, pipeline);
+        return;
+    }
+
+    const std::filesystem::path outputDirectoryPath { outputDirectory / std::filesystem::path { inputFileName }.filename() };
+    std::filesystem::create_directories(outputDirectoryPath);
+
+    //the headers are filtered as they are scanned, so the audio of FSBs that aren't selected is never read
+    std::size_t entryCount { 0 };
+    std::size_t matchCount { 0 };
+    runExtractionPipeline(inputFileName, outputDirectoryPath, format, durable, pipeline,
+        [&](auto&& extract) {
+            forEachFSBEntry(inputFileName, [&](const FSBEntry& entry) {
+                entryCount++;
+                if (!matchesNameFilter(filter, entry.header.fileName.data())) {
+                    return true;
+                }
+                matchCount++;
+                return extract(entry);
+            });
+        }, analyses);
+
+    if (!selectsEverything(filter)) {
+        std::cout << "INFO: " << matchCount << " of " << entryCount << " FSBs matched the filters.\n";
+    }
+}
+
+void outputAudioFiles(
+    const std::string& inputFileName,
+    const std::vector<FSBEntry>& entries,
+    const std::string_view outputDirectory,
+    const OutputFormat format,
+    const bool durable,
+    std::vector<AudioAnalysis> *const analyses,
+    const PipelineConfig& pipeline) {
+
     assert(!inputFileName.empty());
 
-    const std::vector<std::size_t> fsbIndexes { findFSBIndexes(inputFileName) };
+    if (analyses != nullptr) {
+        analyses->assign(entries.size(), AudioAnalysis {});
+    }
 
     const std::filesystem::path inputFileNamePath = { inputFileName };
 
@@ -199,32 +552,108 @@ void outputAudioFiles(const std::string& inputFileName, const std::string_view o
     //case where file has no file extension is checked in sm3tools.cpp
     assert(!fileName.empty());
 
-    const std::filesystem::path outputDirectoryPath { outputDirectory / fileName };
+    if (format == OutputFormat::bundle) {
+        std::vector<BundleInput> inputs {};
+        inputs.reserve(entries.size());
+        for (const FSBEntry& entry : entries) {
+            inputs.push_back({ entry.header.fileName.data(), inputFileName,
+                entry.headerPosition + FSB_HEADER_SIZE, entry.header.dataSize });
+        }
 
+        std::filesystem::create_directories(outputDirectory);
+        std::filesystem::path bundlePath { outputDirectory / fileName };
+        bundlePath.replace_extension(".sm3bundle");
+        writeBundle(inputs, bundlePath.string());
+
+        if (analyses != nullptr) {
+            //the bundle is written by copying straight between the files,
+            //so the audio is analysed from a mapping of the input instead
+            MyIO::FileView view { MyIO::mapfile(inputFileName.c_str()) };
+            parallelFor(entries.size(), [&](const std::size_t i) {
+                const std::size_t dataPosition { std::min(entries[i].headerPosition + FSB_HEADER_SIZE, view.size) };
+                const std::size_t dataSize { std::min<std::size_t>(entries[i].header.dataSize, view.size - dataPosition) };
+                (*analyses)[i] = analyseAudio(entries[i].header, view.data + dataPosition, dataSize);
+            });
+            MyIO::unmapfile(view);
+        }
+        return;
+    }
+
+    const std::filesystem::path outputDirectoryPath { outputDirectory / fileName };
     std::filesystem::create_directories(outputDirectoryPath);
 
-    //we only look at the alternate found FSBs
-    //(1st, 3rd) etc. because each one is duplicated in the PCSSB archive.
-    //the duplicate doesn't have all of the data, so isn't worth outputting
-    for (std::size_t i = 0; i < fsbIndexes.size(); i += 2) {
-        const std::uint32_t fsbDataSize { readDataSize(inputFileName, fsbIndexes[i]) };
-        if (i < (fsbIndexes.size() - 1)) {
-            //apart from the last FSB, actual data size is just distance from the data start until the next FSB
-            const std::size_t actualDataSize { fsbIndexes[i+1] - (fsbIndexes[i] + FSB_HEADER_SIZE) };
-            if (fsbDataSize != actualDataSize) {
-                std::cout << "LOG: Data size value doesn't match actual size!\n";
+    //NOTE: the partial duplicate of each FSB is already left out by readFSBEntries,
+    //it doesn't have all of the data so isn't worth outputting
+    runExtractionPipeline(inputFileName, outputDirectoryPath, format, durable, pipeline,
+        [&entries](auto&& extract) {
+            for (const FSBEntry& entry : entries) {
+                if (!extract(entry)) {
+                    break;
+                }
             }
+        }, analyses);
+}
+
+void outputAudioFiles(
+    std::FILE *const inputStream,
+    const std::string_view streamName,
+    const std::string_view outputDirectory,
+    const OutputFormat format,
+    const bool durable,
+    const NameFilter& filter,
+    std::vector<AudioAnalysis> *const analyses) {
+
+    assert(inputStream != nullptr);
+    assert(!streamName.empty());
+
+    if (format == OutputFormat::bundle) {
+        //the bundle index is written before the data, so every FSB would have to be held in memory
+        std::cerr << "ERROR: The bundle format needs a seekable input file.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    const std::filesystem::path outputDirectoryPath { std::filesystem::path { outputDirectory } / streamName };
+    std::filesystem::create_directories(outputDirectoryPath);
+
+    std::size_t entryCount { 0 };
+    std::size_t matchCount { 0 };
+    MyIO::OutputDirectory directory { MyIO::opendirectory(outputDirectoryPath.string().c_str(), durable) };
+    forEachFSBEntryInStream(inputStream, [&](const FSBEntry& entry,
+        const unsigned char *const data, const std::size_t dataSize) {
+
+        //the data has been read from the stream already, but it doesn't have to be written
+        entryCount++;
+        if (!matchesNameFilter(filter, entry.header.fileName.data())) {
+            return true;
+        }
+        matchCount++;
+
+        if (!entry.dataSizeMatches) {
+            std::cout << "LOG: Data size value doesn't match actual size!\n";
+        }
+        //the stream is read one FSB at a time, so there's nothing to analyse in parallel with
+        if (analyses != nullptr) {
+            analyses->push_back(analyseAudio(entry.header, data, dataSize));
+        }
+
+        if (format == OutputFormat::wav && isWavConvertible(entry.header)) {
+            std::filesystem::path outputAudioFilePath { outputDirectoryPath / entry.header.fileName.data() };
+            outputAudioFilePath.replace_extension(".wav");
+            writeWavData(entry.header, data, dataSize, outputAudioFilePath.string());
+            return true;
+        }
+        if (format == OutputFormat::wav) {
+            std::cout << "LOG: " << entry.header.fileName.data()
+                << " is not PCM or IMA ADPCM, writing it without converting.\n";
         }
-        const std::string fsbFileName = readFileName(inputFileName, fsbIndexes[i]);
 
-        std::filesystem::path outputAudioFilePath { outputDirectoryPath / fsbFileName };
+        MyIO::writefileat(directory, entry.header.fileName.data(), data, dataSize);
+        return true;
+    });
+    MyIO::closedirectory(directory);
 
-        outputAudioData(
-            inputFileName,
-            fsbIndexes[i],
-            FSB_HEADER_SIZE,
-            fsbDataSize,
-            outputAudioFilePath.string());
+    if (!selectsEverything(filter)) {
+        std::cout << "INFO: " << matchCount << " of " << entryCount << " FSBs matched the filters.\n";
     }
 }
 
@@ -235,11 +664,11 @@ std::size_t findFirstFSBMatchingFileName(
     assert(!pcssbFileName.empty());
     assert(!fileNameString.empty());
 
-    const std::vector<std::size_t> fsbIndexes = findFSBIndexes(pcssbFileName);
+    const std::vector<FSBEntry> entries = readFSBEntries(pcssbFileName);
 
-    for (const size_t fsbIndex : fsbIndexes) {
-        if (readFileName(pcssbFileName, fsbIndex) == fileNameString) {
-            return fsbIndex;
+    for (const FSBEntry& entry : entries) {
+        if (entry.header.fileName.data() == fileNameString) {
+            return entry.headerPosition;
         }
     }
 
@@ -247,6 +676,146 @@ std::size_t findFirstFSBMatchingFileName(
     std::exit(EXIT_FAILURE);
 }
 
+//reads up to count bytes from inputFileHandle and writes them to outputFileHandle
+//through two COPY_BUFFER_SIZE buffers. a separate thread reads into one buffer
+//while the calling thread writes out the other, so reading and writing overlap
+//and memory use doesn't depend on count. stops early if the end of the input is reached.
+//returns the number of bytes copied.
+static std::size_t doubleBufferedCopy(
+    std::FILE *const inputFileHandle,
+    std::FILE *const outputFileHandle,
+    const std::size_t count) {
+
+    struct CopyBuffer {
+        std::vector<char> data {};
+        std::size_t size {}; // number of bytes in data waiting to be written
+        bool full {};
+    };
+    std::array<CopyBuffer, 2> buffers {};
+    for (CopyBuffer& buffer : buffers) {
+        buffer.data.resize(COPY_BUFFER_SIZE);
+    }
+    bool readerDone { false };
+    std::mutex mutex {};
+    std::condition_variable bufferChanged {};
+
+    std::thread reader { [&]() {
+        std::size_t remaining { count };
+        for (std::size_t i = 0; remaining > 0; i ^= 1) {
+            CopyBuffer& buffer { buffers[i] };
+            {
+                std::unique_lock<std::mutex> lock { mutex };
+                bufferChanged.wait(lock, [&buffer]() { return !buffer.full; });
+            }
+
+            const std::size_t readCount { std::min(remaining, buffer.data.size()) };
+            const std::size_t numRead { MyIO::fread(buffer.data.data(), sizeof(char), readCount, inputFileHandle) };
+            remaining = numRead < readCount ? 0 : remaining - numRead;
+
+            {
+                const std::lock_guard<std::mutex> lock { mutex };
+                buffer.size = numRead;
+                buffer.full = true;
+            }
+            bufferChanged.notify_all();
+        }
+        {
+            const std::lock_guard<std::mutex> lock { mutex };
+            readerDone = true;
+        }
+        bufferChanged.notify_all();
+    } };
+
+    std::size_t numCopied { 0 };
+    for (std::size_t i = 0; ; i ^= 1) {
+        CopyBuffer& buffer { buffers[i] };
+        {
+            std::unique_lock<std::mutex> lock { mutex };
+            bufferChanged.wait(lock, [&]() { return buffer.full || readerDone; });
+            if (!buffer.full) {
+                //the reader finished without filling this buffer, so everything has been written
+                break;
+            }
+        }
+
+        if (buffer.size > 0) {
+            (void) MyIO::fwrite(buffer.data.data(), sizeof(char), buffer.size, outputFileHandle);
+            numCopied += buffer.size;
+        }
+
+        {
+            const std::lock_guard<std::mutex> lock { mutex };
+            buffer.full = false;
+        }
+        bufferChanged.notify_all();
+    }
+
+    reader.join();
+    return numCopied;
+}
+
+RepackResult repackPCSSB(
+    const std::string& inputFilePath,
+    const std::string& outputFilePath,
+    const std::size_t alignment) {
+
+    assert(!inputFilePath.empty());
+    assert(!outputFilePath.empty());
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    const std::vector<FSBEntry> entries { readFSBEntries(inputFilePath) };
+
+    RepackResult result {};
+    result.fsbCount = entries.size();
+    result.originalSize = static_cast<std::size_t>(MyIO::getfilesize(inputFilePath.c_str()));
+    result.leadingSize = entries.empty() ? result.originalSize : entries.front().headerPosition;
+
+    std::FILE *const inputFileHandle { MyIO::fopen(inputFilePath.c_str(), "rb") };
+    std::FILE *const outputFileHandle { MyIO::fopen(outputFilePath.c_str(), "wb") };
+    {
+        const std::vector<char> zeroes(alignment, '\0');
+        std::size_t outputPosition { 0 };
+        //the data before the first FSB is copied first, then each FSB with its partial duplicate
+        for (std::size_t i = 0; i <= entries.size(); i++) {
+            const std::size_t segmentStart { i == 0 ? 0 : entries[i - 1].headerPosition };
+            const std::size_t segmentEnd { i == entries.size() ? result.originalSize : entries[i].headerPosition };
+            if (i > 0) {
+                const std::size_t paddingSize { (alignment - outputPosition % alignment) % alignment };
+                if (paddingSize > 0) {
+                    (void) MyIO::fwrite(zeroes.data(), sizeof(char), paddingSize, outputFileHandle);
+                }
+                outputPosition += paddingSize;
+                result.paddingSize += paddingSize;
+            }
+
+            if (segmentEnd > segmentStart) {
+                MyIO::fseekunsigned(inputFileHandle, segmentStart, SEEK_SET);
+                outputPosition += doubleBufferedCopy(inputFileHandle, outputFileHandle, segmentEnd - segmentStart);
+            }
+        }
+        result.repackedSize = outputPosition;
+    }
+    (void) std::fclose(outputFileHandle);
+    (void) std::fclose(inputFileHandle);
+
+    //the FSBs have to be found again in the same order, at aligned positions, with the same
+    //names and data sizes (the padding only goes after the end of each FSB's data)
+    const std::vector<FSBEntry> repackedEntries { readFSBEntries(outputFilePath) };
+    bool isValid { repackedEntries.size() == entries.size() };
+    for (std::size_t i = 0; isValid && i < entries.size(); i++) {
+        isValid = repackedEntries[i].headerPosition % alignment == 0
+            && repackedEntries[i].header.fileName == entries[i].header.fileName
+            && repackedEntries[i].header.dataSize == entries[i].header.dataSize;
+    }
+    if (!isValid) {
+        std::cerr << "ERROR: The FSBs in the repacked file " << outputFilePath
+            << " don't match the original. It shouldn't be used.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    return result;
+}
+
 void readAndWriteToNewFile(
     const std::string& inputFileName,
     const std::string& outputFileName,
@@ -259,40 +828,126 @@ void readAndWriteToNewFile(
     assert(!outputFileName.empty());
     assert(readCount > 0);
 
-    //store bytes from input in intermediate buffer
-    //(plus one extra byte for null terminator)
-    //NOTE: buffer is initialized to 0 to ensure that the bytes of it that don't get read to
-    // can still be written to the file as "zero padding" if padWithZeroes is enabled.
-    char *const buffer { new char[readCount + 1]{} };
+    std::FILE *const inputFileHandle { MyIO::fopen(inputFileName.c_str(), "rb") };
     {
-        std::FILE *const inputFileHandle { MyIO::fopen(inputFileName.c_str(), "rb") };
+        MyIO::fseekunsigned(inputFileHandle, readPosition, SEEK_SET);
+
+        //either append or write depending on append argument
+        //NOTE: we create an outputMode variable this way so that
+        // we can keep outputFileHandle const
+        const char *const outputMode { append ? "ab" : "wb" };
+        std::FILE *const outputFileHandle { MyIO::fopen(outputFileName.c_str(), outputMode) };
         {
-            MyIO::fseekunsigned(inputFileHandle, readPosition, SEEK_SET);
+            const std::size_t numCopied { doubleBufferedCopy(inputFileHandle, outputFileHandle, readCount) };
+
+            //if padWithZeroes is true, write null (00) bytes for the
+            //remaining bytes that couldn't be read
+            if (padWithZeroes && numCopied < readCount) {
+                const std::vector<char> zeroes(std::min(readCount - numCopied, COPY_BUFFER_SIZE), '\0');
+                for (std::size_t remaining = readCount - numCopied; remaining > 0;) {
+                    const std::size_t writeCount { std::min(remaining, zeroes.size()) };
+                    (void) MyIO::fwrite(zeroes.data(), sizeof(char), writeCount, outputFileHandle);
+                    remaining -= writeCount;
+                }
+            }
+        }
+        (void) std::fclose(outputFileHandle);
+    }
+    (void) std::fclose(inputFileHandle);
+}
+
+void copyFile(
+    const std::string& inputFileName,
+    const std::string& outputFileName) {
+
+    assert(!inputFileName.empty());
+    assert(!outputFileName.empty());
+
+    if (MyIO::clonefile(inputFileName.c_str(), outputFileName.c_str())) {
+        return;
+    }
+
+    const auto fileSize { static_cast<std::size_t>(MyIO::getfilesize(inputFileName.c_str())) };
+    if (fileSize == 0) {
+        //just create the empty output file
+        (void) std::fclose(MyIO::fopen(outputFileName.c_str(), "wb"));
+        return;
+    }
+    readAndWriteToNewFile(inputFileName, outputFileName, fileSize, 0, false, false);
+}
+
+void overwriteRegionWithFile(
+    const std::string& inputFileName,
+    const std::string& outputFileName,
+    const std::size_t regionSize,
+    const std::size_t writePosition) {
+
+    assert(!inputFileName.empty());
+    assert(!outputFileName.empty());
+
+    if (regionSize == 0) {
+        return;
+    }
+
+    //NOTE: buffer is initialized to 0 so that the bytes of it that don't get read to
+    // are written as the zero padding
+    std::vector<char> buffer(regionSize, '\0');
+
+    std::FILE *const inputFileHandle { MyIO::fopen(inputFileName.c_str(), "rb") };
+    {
+        (void) MyIO::fread(buffer.data(), sizeof(char), regionSize, inputFileHandle);
+    }
+    (void) std::fclose(inputFileHandle);
+
+    std::FILE *const outputFileHandle { MyIO::fopen(outputFileName.c_str(), "r+b") };
+    {
+        MyIO::fseekunsigned(outputFileHandle, writePosition, SEEK_SET);
+        (void) MyIO::fwrite(buffer.data(), sizeof(char), regionSize, outputFileHandle);
+    }
+    (void) std::fclose(outputFileHandle);
+}
 
-            const std::size_t numRead { MyIO::fread(buffer, sizeof(char), readCount, inputFileHandle) };
+std::size_t applyAudioReplacements(
+    const std::string& outputFilePath,
+    std::vector<AudioReplacement> replacements) {
 
-            //if padWithZeroes is false, only write the bytes that have been read
-            //if padWithZeroes is true, write the entire length of the buffer,
-            // with the remaining bytes being 00
-            const std::size_t numToWrite { padWithZeroes ? readCount : numRead };
+    assert(!outputFilePath.empty());
 
-            assert(numToWrite <= readCount);
-            //null terminate buffer string for safety
-            buffer[numToWrite] = '\0';
+    std::sort(replacements.begin(), replacements.end(),
+        [](const AudioReplacement& lhs, const AudioReplacement& rhs) {
+            return lhs.dataPosition < rhs.dataPosition;
+        });
+
+    std::size_t numApplied { 0 };
+    std::vector<char> buffer {};
+
+    std::FILE *const outputFileHandle { MyIO::fopen(outputFilePath.c_str(), "r+b") };
+    for (const AudioReplacement& replacement : replacements) {
+        const std::intmax_t replaceDataSize = MyIO::getfilesize(replacement.replaceFilePath.c_str());
+        if (static_cast<std::size_t>(replaceDataSize) > replacement.dataSize) {
+            std::cerr << "ERROR: " << replacement.replaceFilePath << " has a larger file size than"
+                            " the original audio, skipping it.\n";
+            continue;
+        }
 
-            //either append or write depending on append argument
-            //NOTE: we create an outputMode variable this way so that
-            // we can keep outputFileHandle const
-            const char *const outputMode { append ? "ab" : "wb" };
-            std::FILE *const outputFileHandle { MyIO::fopen(outputFileName.c_str(), outputMode) };
+        //NOTE: buffer is reset to 0 so that the bytes of it that don't get read to
+        // are written as the zero padding
+        buffer.assign(replacement.dataSize, '\0');
+        if (!buffer.empty()) {
+            std::FILE *const inputFileHandle { MyIO::fopen(replacement.replaceFilePath.c_str(), "rb") };
             {
-                (void) MyIO::fwrite(buffer, sizeof(char), numToWrite, outputFileHandle);
+                (void) MyIO::fread(buffer.data(), sizeof(char), buffer.size(), inputFileHandle);
             }
-            (void) std::fclose(outputFileHandle);
+            (void) std::fclose(inputFileHandle);
+
+            MyIO::fseekunsigned(outputFileHandle, replacement.dataPosition, SEEK_SET);
+            (void) MyIO::fwrite(buffer.data(), sizeof(char), buffer.size(), outputFileHandle);
         }
-        (void) std::fclose(inputFileHandle);
+        numApplied++;
     }
-    delete[] buffer;
+    (void) std::fclose(outputFileHandle);
+
+    return numApplied;
 }
 
 void replaceLongInFile(
@@ -345,34 +1000,16 @@ void replaceAudioinPCSSB(
     //TODO could trim metadata from the replacement audio
 
     const std::size_t fsbAudioDataIndex = fsbHeaderIndex + FSB_HEADER_SIZE;
-    //write everything up to the existing audio data into the output files
-    readAndWriteToNewFile(
-        pcssbFilePath,
-        outputFilePath,
-        fsbAudioDataIndex,
-        0,
-        false,
-        false);
+    //start from a copy of the whole original file
+    copyFile(pcssbFilePath, outputFilePath);
 
-    //append the replacement audio data into the output file
-    readAndWriteToNewFile(
+    //overwrite the existing audio data with the replacement audio data
+    //(padded with zeroes up to the original size)
+    overwriteRegionWithFile(
         replaceFilePath,
         outputFilePath,
         originalDataSize,
-        0,
-        true,
-        true);
-
-    //append the rest of the original file after the audio data
-    readAndWriteToNewFile(
-        pcssbFilePath,
-        outputFilePath,
-        //NOTE: this will overflow but it shouldn't matter
-        //ensures all the bytes after from original file is read
-        static_cast<std::size_t>(MyIO::getfilesize(pcssbFilePath.c_str())),
-        fsbAudioDataIndex + originalDataSize,
-        true,
-        false);
+        fsbAudioDataIndex);
 
     /* NOTE: we currently don't modify the data size field in the FSB because
         we only insert the replacement audio when it is smaller than
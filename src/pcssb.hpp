@@ -20,55 +20,190 @@
 #ifndef PCSSB_H
 #define PCSSB_H
 #include <string>
+#include <string_view>
 #include <vector>
+#include <array>
+#include <utility>
 
 #include <cstddef>
 #include <cstdint>
+#include <cstdio>
 
-struct FSB {
-    std::uint32_t fsb3Header {}; // "FSB3"
+#include "filter.hpp"
+#include "pipeline.hpp"
+#include "archiveengine.hpp"
 
-    std::uint32_t numFiles {}; // = 1
+struct AudioAnalysis;
 
-    std::uint32_t unknown1 {}; // = 80
+//maximum number of bytes used to store the sample filename in FSB3 archives
+//NOTE that if the length of the file name takes the entire 30 bytes,
+//an extra byte will be needed for the null terminator.
+constexpr int FSB_FILENAME_SIZE { 30 };
 
-    std::uint32_t dataSize {};
+constexpr int FSB_HEADER_SIZE { 104 };
 
-    std::uint32_t unknown2 {}; // = 196609
-    std::uint32_t null1 {};
+//byte offsets of each field within the 104 byte FSB3 header
+//(the 24 byte file header followed by the single 80 byte sample header).
+//all multi-byte fields are stored little-endian.
+namespace FSBField {
+    constexpr std::size_t MAGIC { 0 }; // "FSB3"
+    constexpr std::size_t NUM_SAMPLES { 4 }; // = 1
+    constexpr std::size_t SAMPLE_HEADERS_SIZE { 8 }; // = 80
+    constexpr std::size_t DATA_SIZE { 12 };
+    constexpr std::size_t VERSION { 16 }; // = 196609 (0x00030001)
+    constexpr std::size_t ARCHIVE_MODE { 20 }; // = 0
+    constexpr std::size_t ENTRY_SIZE { 24 }; // = 80 ("P\0"), uint16
+    constexpr std::size_t FILENAME { 26 }; // FSB_FILENAME_SIZE bytes
+    constexpr std::size_t LENGTH_SAMPLES { 56 };
+    constexpr std::size_t LENGTH_COMPRESSED { 60 };
+    constexpr std::size_t LOOP_START { 64 };
+    constexpr std::size_t LOOP_END { 68 };
+    constexpr std::size_t MODE { 72 }; // e.g. 8768 (0x2240)
+    constexpr std::size_t FREQUENCY { 76 }; // e.g. 48000
+    constexpr std::size_t DEFAULT_VOLUME { 80 }; // uint16
+    constexpr std::size_t DEFAULT_PAN { 82 }; // uint16
+    constexpr std::size_t DEFAULT_PRIORITY { 84 }; // uint16, = 128
+    constexpr std::size_t NUM_CHANNELS { 86 }; // uint16
+    constexpr std::size_t MIN_DISTANCE { 88 }; // float, = 1.0
+    constexpr std::size_t MAX_DISTANCE { 92 }; // float, = 10000.0
+    constexpr std::size_t VARIATION_FREQUENCY { 96 };
+    constexpr std::size_t VARIATION_VOLUME { 100 }; // uint16
+    constexpr std::size_t VARIATION_PAN { 102 }; // uint16
+}
+static_assert(FSBField::VARIATION_PAN + sizeof(std::uint16_t) == FSB_HEADER_SIZE);
+static_assert(FSBField::FILENAME + FSB_FILENAME_SIZE == FSBField::LENGTH_SAMPLES);
 
-    std::uint16_t entrySize {}; // = 80 ("P\0")
+//flags used in the sample mode field (FSBHeader::mode).
+//these are the FMOD 3 FSOUND_* mode flags.
+namespace FSBMode {
+    constexpr std::uint32_t BITS_8 { 0x00000008 };
+    constexpr std::uint32_t BITS_16 { 0x00000010 };
+    constexpr std::uint32_t MONO { 0x00000020 };
+    constexpr std::uint32_t STEREO { 0x00000040 };
+    constexpr std::uint32_t UNSIGNED { 0x00000080 };
+    constexpr std::uint32_t SIGNED { 0x00000100 };
+    //FSBs use this flag to mark MPEG compressed data
+    constexpr std::uint32_t MPEG { 0x00000200 };
+    constexpr std::uint32_t IMAADPCM { 0x00400000 };
+    constexpr std::uint32_t VAG { 0x00800000 };
+    constexpr std::uint32_t XMA { 0x01000000 };
+    constexpr std::uint32_t GCADPCM { 0x02000000 };
+}
 
-    char* fileName {}; // 30 bytes
+//decoded copy of every field in an FSB3 header. This is plain data with no
+//pointers so it can be freely copied, and its layout is independent of the on-disk
+//layout (which is described by the offsets in FSBField) so host endianness and
+//struct padding don't matter.
+struct FSBHeader {
+    std::uint32_t numSamples {};
+    std::uint32_t sampleHeadersSize {};
+    std::uint32_t dataSize {};
+    std::uint32_t version {};
+    std::uint32_t archiveMode {};
 
-    std::uint32_t unknown3 {};
-    std::uint32_t unknown4 {};
-    std::uint32_t null2 {};
-    std::uint32_t unknown5 {};
-    std::uint32_t unknown6 {}; // = 8768
-    std::uint32_t unknown7 {}; // = 48000
-    std::uint32_t unknown8 {}; // = 1
-    std::uint32_t unknown9 {}; // = 131200
-    std::uint32_t unknown10 {}; // = 1065353216
-    std::uint32_t unknown11 {}; // = 1176256512
-    std::uint32_t null3 {};
-    std::uint32_t null4 {};
+    std::uint16_t entrySize {};
+    //NOTE: one extra byte so that the name is always null terminated
+    std::array<char, FSB_FILENAME_SIZE + 1> fileName {};
 
-    char* data {};
+    std::uint32_t lengthSamples {};
+    std::uint32_t lengthCompressed {};
+    std::uint32_t loopStart {};
+    std::uint32_t loopEnd {};
+    std::uint32_t mode {};
+    std::uint32_t frequency {};
+    std::uint16_t defaultVolume {};
+    std::uint16_t defaultPan {};
+    std::uint16_t defaultPriority {};
+    std::uint16_t numChannels {};
+    float minDistance {};
+    float maxDistance {};
+    std::uint32_t variationFrequency {};
+    std::uint16_t variationVolume {};
+    std::uint16_t variationPan {};
 };
 
+//decodes the FSB_HEADER_SIZE bytes pointed to by bytes (which must start
+//with the "FSB3" header text) into an FSBHeader.
+FSBHeader decodeFSBHeader(const unsigned char *bytes);
+
+//Reads the entire header of the FSB file that starts at fsb3HeaderPosition
+//with a single read and decodes it.
+//fsb3HeaderPosition must be the location of the start of the "FSB3" header string.
+FSBHeader readFSBHeader(
+    const std::string& inputFileName,
+    std::size_t fsb3HeaderPosition);
+
+//same as above but reads from an already open file, so that callers reading
+//many headers don't have to reopen the file for each one.
+//the file position indicator is left at the end of the header.
+FSBHeader readFSBHeader(std::FILE *fileHandle, std::size_t fsb3HeaderPosition);
+
 // "FSB3" text that is at the start of each FSB file
 constexpr std::string_view FSB_MAGIC_STRING { "FSB3" };
 
-//finds every instance of "FSB3" header text in the file given by the filePath,
-//and puts the absolute position in bytes of the start of those instances
-//(in order from the start of the file) into the vector that is returned.
-//The size of the vector is the number of instances that were found.
-std::vector<size_t> findFSBIndexes(const std::string& filePath);
+//checks that the fixed fields of a decoded header have the values every
+//FSB in a PCSSB has, to tell real headers apart from "FSB3" text that
+//happens to appear in audio data.
+bool isValidFSBHeader(const FSBHeader& header);
+
+//describes the layout of a PCSSB for the engines in archiveengine.hpp (see archiveformat.hpp):
+//a series of FSB3 files, each with one sample, and each followed by a partial duplicate of itself.
+struct PCSSBFormat {
+    using Header = FSBHeader;
+    static constexpr std::string_view MAGIC { FSB_MAGIC_STRING };
+    static constexpr std::size_t HEADER_SIZE { FSB_HEADER_SIZE };
+
+    static Header decodeHeader(const unsigned char *const bytes) { return decodeFSBHeader(bytes); }
+    static bool isValidHeader(const Header& header) { return isValidFSBHeader(header); }
+    static std::size_t dataSize(const Header& header) { return header.dataSize; }
+    static const char *entryName(const Header& header) { return header.fileName.data(); }
+    //each FSB is followed by a partial duplicate of it with the same name
+    static bool isPartialDuplicate(const Header& header, const Header& previous) {
+        return header.fileName == previous.fileName;
+    }
+};
+static_assert(isValidArchiveFormat<PCSSBFormat>());
+
+//an FSB within a PCSSB, excluding the partial duplicates that follow each one.
+using FSBEntry = ArchiveEntry<PCSSBFormat>;
+
+//finds every FSB in the PCSSB at filePath (skipping the duplicates)
+//and decodes its header. Entries are in order from the start of the file.
+//Rather than searching every byte, this follows the structure of the archive:
+//after reading a header it jumps over the header and data to where the next FSB
+//should be. The file is only searched for "FSB3" when that jump doesn't land on
+//a valid header (e.g. after the partial duplicates, or when a data size is wrong),
+//and then only from the end of the current header up to the next match.
+std::vector<FSBEntry> readFSBEntries(const std::string& filePath);
+
+//same as readFSBEntries, but calls callback with each entry as soon as it is found
+//instead of collecting them. if callback returns false the rest of the file isn't read.
+//callback is passed straight through to the engine, so it can be inlined into the walk.
+template <typename Callback>
+void forEachFSBEntry(const std::string& filePath, Callback&& callback) {
+    forEachArchiveEntry<PCSSBFormat>(filePath, std::forward<Callback>(callback));
+}
+
+//same as forEachFSBEntry, but for a stream that can only be read forwards once
+//(e.g. standard input or a pipe). callback is also given the FSB's audio data
+//(which is only valid during the call, and can be shorter than header.dataSize
+//if the stream ended early). headerPosition is counted from the start of the stream.
+//at most one FSB's data plus two headers is held in memory at once.
+template <typename Callback>
+void forEachFSBEntryInStream(std::FILE *const stream, Callback&& callback) {
+    forEachArchiveEntryInStream<PCSSBFormat>(stream, std::forward<Callback>(callback));
+}
+
+//recursively finds every file with the .pcssb extension in directory.
+//the returned paths are sorted so the order is stable between runs.
+std::vector<std::string> findPCSSBFiles(const std::string& directory);
 
 //prints out information about each FSB (excluding duplicates) in the file.
 void printFSBList(const std::string& filePath);
 
+//same as above, but reads the PCSSB from a stream in a single pass.
+void printFSBList(std::FILE *inputStream);
+
 constexpr int DATA_SIZE_OFFSET { 3 * sizeof(std::uint32_t) };
 
 //Reads the data size field in the FSB file that starts at fsb3HeaderPosition.
@@ -80,14 +215,11 @@ std::uint32_t readDataSize(
     const std::string& inputFileName,
     std::size_t fsb3HeaderPosition);
 
-//maximum number of bytes used to store the sample filename in FSB3 archives
-//NOTE that if the length of the file name takes the entire 30 bytes,
-//an extra byte will be needed for the null terminator.
-constexpr int FSB_FILENAME_SIZE { 30 };
-
 //NOTE: skips 6 longs which are the other header information including "FSB3" text
 //before the entry starts, and then skips 2 bytes which is the entry size (which =80)
 constexpr int FILENAME_OFFSET { 2 + (6 * sizeof(uint32_t)) };
+static_assert(FILENAME_OFFSET == FSBField::FILENAME);
+static_assert(DATA_SIZE_OFFSET == FSBField::DATA_SIZE);
 
 //Reads the file name field in the FSB file that starts at fsb3HeaderPosition.
 //fsb3HeaderPosition must be the location of the start of the "FSB3" header string.
@@ -102,13 +234,14 @@ std::size_t findFirstFSBMatchingFileName(
     const std::string& pcssbFileName,
     const std::string& fileNameString);
 
-constexpr int FSB_HEADER_SIZE { 104 };
-
 //uses the filename of the file pointed to by replaceFilePath to find the relevant
 //FSB that has a matching filename field. then replaces the audio data
 //in that FSB with the contents of the file at replaceFilePath
 //into the file at outputFilePath. Creates the file if it does not exist, replaces
 //it if it does exist.
+//The output starts as a copy of the PCSSB made with copyFile, and then only the
+//audio data of the matching FSB is overwritten, so on filesystems with reflinks
+//only the replaced audio takes up new space.
 void replaceAudioinPCSSB(
     const std::string& pcssbFilePath,
     const std::string& replaceFilePath,
@@ -123,11 +256,65 @@ void outputAudioData(
     std::size_t dataSize,
     const std::string& outputFileName);
 
+//the format that extracted audio is written in
+enum class OutputFormat {
+    raw, // the audio data exactly as it is stored in the FSB
+    wav, // PCM and IMA ADPCM audio decoded into a PCM WAV file
+    bundle, // all audio data in one memory mappable file with a sorted index (see bundle.hpp)
+};
+
 //Writes the audio data of all FSB files in a PCSSB into separate files.
 //Written to a folder that has the name of the input file, in outputDirectory.
 //Assumes various things about the file that are likely only true for the Spider-Man 3
 //PC .PCSSB files. For example, each FSB file is partly duplicated so we don't output the duplicate.
-void outputAudioFiles(const std::string& inputFileName, std::string_view outputDirectory);
+//The archive is scanned, read and written in a pipeline (see PipelineConfig), so files
+//start being written before the whole archive has been scanned.
+//With OutputFormat::wav, files are converted in parallel and given a .wav extension,
+//FSBs in formats that can't be converted are written raw.
+//With OutputFormat::bundle, a single file with the stem of the input file and the
+//.sm3bundle extension is written into outputDirectory instead of a folder.
+//If durable is true, the files are guaranteed to be flushed to disk when this returns
+//(the flushes are batched together rather than done after every file).
+//Only FSBs with names selected by filter are written. Filtering is done on the
+//headers, so the audio data of FSBs that aren't selected is never read.
+//If analyses isn't null, the audio of each FSB that is written is also analysed
+//while it is in memory (in parallel), and the results are put into analyses
+//in the same order as the FSBs (see analysis.hpp).
+void outputAudioFiles(
+    const std::string& inputFileName,
+    std::string_view outputDirectory,
+    OutputFormat format = OutputFormat::raw,
+    bool durable = false,
+    const NameFilter& filter = {},
+    std::vector<AudioAnalysis> *analyses = nullptr,
+    const PipelineConfig& pipeline = {});
+
+//same as above, but only writes the given entries of the PCSSB
+//(e.g. a subset of the ones returned by readFSBEntries).
+void outputAudioFiles(
+    const std::string& inputFileName,
+    const std::vector<FSBEntry>& entries,
+    std::string_view outputDirectory,
+    OutputFormat format = OutputFormat::raw,
+    bool durable = false,
+    std::vector<AudioAnalysis> *analyses = nullptr,
+    const PipelineConfig& pipeline = {});
+
+//same as above, but reads the PCSSB from a stream (e.g. standard input) in a single
+//forward pass, writing each FSB out as soon as its data has been read.
+//files are written to a folder called streamName in outputDirectory.
+//OutputFormat::bundle isn't supported (it logs an error and exits).
+void outputAudioFiles(
+    std::FILE *inputStream,
+    std::string_view streamName,
+    std::string_view outputDirectory,
+    OutputFormat format = OutputFormat::raw,
+    bool durable = false,
+    const NameFilter& filter = {},
+    std::vector<AudioAnalysis> *analyses = nullptr);
+
+//size of each of the two buffers used by readAndWriteToNewFile
+constexpr std::size_t COPY_BUFFER_SIZE { 1024 * 1024 };
 
 //reads readCount bytes from input (starting from readPosition)
 //and writes those bytes to the output file
@@ -140,6 +327,8 @@ void outputAudioFiles(const std::string& inputFileName, std::string_view outputD
 //read are written to the output, so the amount written may be less
 //than readCount.
 //creates output file if it does not exist.
+//the data is copied through a fixed pair of COPY_BUFFER_SIZE buffers, with reading
+//and writing happening at the same time, so memory use doesn't depend on readCount.
 void readAndWriteToNewFile(
     const std::string& inputFileName,
     const std::string& outputFileName,
@@ -148,6 +337,63 @@ void readAndWriteToNewFile(
     bool append,
     bool padWithZeroes);
 
+//makes outputFileName an exact copy of inputFileName (creating it if it does not exist).
+//uses MyIO::clonefile so that the copy is a reflink where the filesystem supports it,
+//and falls back to copying the data with readAndWriteToNewFile otherwise.
+void copyFile(
+    const std::string& inputFileName,
+    const std::string& outputFileName);
+
+//reads up to regionSize bytes from the start of inputFileName and writes them into
+//the existing file outputFileName at writePosition, replacing what was there.
+//if fewer than regionSize bytes are read, the rest of the region is filled with null (00) bytes.
+//nothing outside of the region is changed.
+void overwriteRegionWithFile(
+    const std::string& inputFileName,
+    const std::string& outputFileName,
+    std::size_t regionSize,
+    std::size_t writePosition);
+
+//how a repack with repackPCSSB changed the layout of a PCSSB
+struct RepackResult {
+    std::size_t fsbCount {};
+    std::size_t originalSize {};
+    std::size_t repackedSize {};
+    std::size_t paddingSize {}; // bytes of zeroes added in front of FSBs
+    std::size_t leadingSize {}; // bytes before the first FSB, which are copied unchanged
+};
+
+//writes a copy of the PCSSB at inputFilePath to outputFilePath with the header of
+//every FSB starting on a multiple of alignment (a power of two, e.g. 2048 for disc
+//sectors or 4096 for pages), by putting zeroes in front of FSBs that don't already.
+//Everything from one FSB up to the next (i.e. its partial duplicate) is copied as it is,
+//as is the data before the first FSB. NOTE: what that data holds isn't known, so if it has
+//offsets or sizes of the FSBs they aren't updated. FSB3 headers don't hold any offsets, so the headers
+//and their data size fields are unchanged (the padding only goes after the end of each
+//FSB's data). The output is read back to check that every FSB is found again at an aligned
+//position with the same name and data size; if not, the error is logged and the program exits.
+//repacking an already aligned PCSSB leaves it as it is.
+RepackResult repackPCSSB(
+    const std::string& inputFilePath,
+    const std::string& outputFilePath,
+    std::size_t alignment);
+
+//audio data in a PCSSB to replace with the contents of another file
+struct AudioReplacement {
+    std::size_t dataPosition {}; // absolute position of the FSB's audio data
+    std::uint32_t dataSize {}; // size of the FSB's audio data
+    std::string replaceFilePath {};
+};
+
+//overwrites the audio data of several FSBs in the existing file outputFilePath
+//with one open of the output, in order of position. Each replacement is padded
+//with zeroes up to the original data size. Replacements larger than the
+//original data are skipped with an error message rather than exiting.
+//returns the number of replacements that were written.
+std::size_t applyAudioReplacements(
+    const std::string& outputFilePath,
+    std::vector<AudioReplacement> replacements);
+
 //replace a uint32_t field in a file.
 //the field has to be exactly sizeof(uint32_t) bytes, any less or more
 //and the write will not work as expected.
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <utility>
+
+#include <cassert>
+#include <cstddef>
+
+//how many threads work on each stage of a pipelined extraction (see outputAudioFiles)
+//and how many items can wait between stages. the scan stage always runs on the
+//calling thread, because where each header is depends on the one before it.
+struct PipelineConfig {
+    std::size_t decodeThreads { 0 }; // 0 means one per hardware thread (see workerCount)
+    std::size_t writeThreads { 2 };
+    //items that can wait in each queue before the stage feeding it has to stop and wait.
+    //this (and the number of threads) is what limits how much audio is in memory at once
+    std::size_t queueDepth { 16 };
+};
+
+//a first in first out queue with a maximum size that can be shared between threads.
+//pushing to a full queue waits until an item is taken out, so a fast stage can't get
+//too far ahead of a slow one. once closed, popping returns false after the queue empties.
+//NOTE: use pushQueue, popQueue and closeQueue rather than the members directly.
+template <typename T>
+struct BoundedQueue {
+    std::size_t capacity { 1 };
+    std::deque<T> items {};
+    bool closed { false };
+    std::mutex mutex {};
+    std::condition_variable notFull {};
+    std::condition_variable notEmpty {};
+};
+
+//adds item to the back of the queue, waiting while it is full.
+template <typename T>
+void pushQueue(BoundedQueue<T>& queue, T&& item) {
+    {
+        std::unique_lock<std::mutex> lock { queue.mutex };
+        queue.notFull.wait(lock, [&queue]() { return queue.items.size() < queue.capacity; });
+        assert(!queue.closed);
+        queue.items.push_back(std::move(item));
+    }
+    queue.notEmpty.notify_one();
+}
+
+//takes the item at the front of the queue into item, waiting while it is empty.
+//returns false (leaving item alone) if the queue is empty and has been closed.
+template <typename T>
+bool popQueue(BoundedQueue<T>& queue, T& item) {
+    {
+        std::unique_lock<std::mutex> lock { queue.mutex };
+        queue.notEmpty.wait(lock, [&queue]() { return !queue.items.empty() || queue.closed; });
+        if (queue.items.empty()) {
+            return false;
+        }
+        item = std::move(queue.items.front());
+        queue.items.pop_front();
+    }
+    queue.notFull.notify_one();
+    return true;
+}
+
+//marks that nothing else will be pushed, waking anything waiting to pop.
+template <typename T>
+void closeQueue(BoundedQueue<T>& queue) {
+    {
+        const std::lock_guard<std::mutex> lock { queue.mutex };
+        queue.closed = true;
+    }
+    queue.notEmpty.notify_all();
+}
+
+//starts threadCount threads that each call func(t), where t is the thread's number in the stage.
+//NOTE: the threads have to be joined with joinStage.
+template <typename Func>
+std::vector<std::thread> startStage(const std::size_t threadCount, Func&& func) {
+    std::vector<std::thread> threads {};
+    threads.reserve(threadCount);
+    for (std::size_t t = 0; t < threadCount; t++) {
+        threads.emplace_back(func, t);
+    }
+    return threads;
+}
+
+//waits for every thread of a stage started with startStage to finish.
+inline void joinStage(std::vector<std::thread>& threads) {
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+}
+
+#endif
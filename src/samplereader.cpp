@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "samplereader.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+#include <cstring>
+
+#include "myIO.hpp"
+#include "pcssb.hpp"
+
+SampleArchive openSampleArchive(const std::string& filePath, const std::size_t cacheSize) {
+    assert(!filePath.empty());
+
+    SampleArchive archive {};
+    archive.filePath = filePath;
+    archive.fileSize = static_cast<std::size_t>(MyIO::getfilesize(filePath.c_str()));
+
+    for (const FSBEntry& entry : readFSBEntries(filePath)) {
+        const std::size_t dataPosition { std::min(entry.headerPosition + FSB_HEADER_SIZE, archive.fileSize) };
+        const std::size_t dataSize { std::min<std::size_t>(entry.header.dataSize, archive.fileSize - dataPosition) };
+        //emplace doesn't replace an FSB with the same name that was found earlier
+        (void) archive.samples.emplace(entry.header.fileName.data(), SampleLocation { dataPosition, dataSize });
+    }
+
+    const std::size_t blocksPerShard {
+        std::max<std::size_t>(cacheSize / SAMPLE_BLOCK_SIZE / SAMPLE_CACHE_SHARD_COUNT, 1) };
+    archive.shards = std::vector<SampleCacheShard>(SAMPLE_CACHE_SHARD_COUNT);
+    for (SampleCacheShard& shard : archive.shards) {
+        //each shard reads through its own handle, so reads in different shards don't wait for each other
+        shard.fileHandle = MyIO::fopen(filePath.c_str(), "rb");
+        shard.capacity = blocksPerShard;
+    }
+    return archive;
+}
+
+void closeSampleArchive(SampleArchive& archive) {
+    for (SampleCacheShard& shard : archive.shards) {
+        if (shard.fileHandle != nullptr) {
+            (void) std::fclose(shard.fileHandle);
+        }
+    }
+    archive = SampleArchive {};
+}
+
+std::optional<std::size_t> sampleDataSize(const SampleArchive& archive, const std::string_view name) {
+    const auto sample { archive.samples.find(name) };
+    if (sample == archive.samples.end()) {
+        return std::nullopt;
+    }
+    return sample->second.dataSize;
+}
+
+//returns the cached block at blockIndex, reading it from the archive first if it isn't cached.
+//shard.mutex has to be locked, and the block is only valid until it is unlocked.
+static const CachedBlock& getCachedBlock(
+    const SampleArchive& archive,
+    SampleCacheShard& shard,
+    const std::size_t blockIndex) {
+
+    const auto cached { shard.blockLookup.find(blockIndex) };
+    if (cached != shard.blockLookup.end()) {
+        shard.hits++;
+        shard.blocks.splice(shard.blocks.begin(), shard.blocks, cached->second);
+        return shard.blocks.front();
+    }
+
+    shard.misses++;
+    if (shard.blocks.size() < shard.capacity) {
+        shard.blocks.emplace_front();
+    }
+    else {
+        //the least recently used block is evicted, and its buffer is reused
+        shard.blockLookup.erase(shard.blocks.back().blockIndex);
+        shard.blocks.splice(shard.blocks.begin(), shard.blocks, std::prev(shard.blocks.end()));
+    }
+
+    CachedBlock& block { shard.blocks.front() };
+    const std::size_t blockPosition { blockIndex * SAMPLE_BLOCK_SIZE };
+    block.blockIndex = blockIndex;
+    block.data.resize(std::min(SAMPLE_BLOCK_SIZE, archive.fileSize - std::min(blockPosition, archive.fileSize)));
+    if (!block.data.empty()) {
+        MyIO::fseekunsigned(shard.fileHandle, blockPosition, SEEK_SET);
+        block.data.resize(MyIO::fread(block.data.data(), sizeof(char), block.data.size(), shard.fileHandle));
+    }
+    shard.blockLookup[blockIndex] = shard.blocks.begin();
+    return block;
+}
+
+std::optional<std::size_t> readSampleRange(
+    SampleArchive& archive,
+    const std::string_view name,
+    const std::size_t offset,
+    const std::size_t length,
+    unsigned char *const buffer) {
+
+    assert(buffer != nullptr || length == 0);
+    assert(!archive.shards.empty());
+
+    const auto sample { archive.samples.find(name) };
+    if (sample == archive.samples.end()) {
+        return std::nullopt;
+    }
+    const SampleLocation& location { sample->second };
+    if (offset >= location.dataSize) {
+        return 0;
+    }
+
+    const std::size_t start { location.dataPosition + offset };
+    const std::size_t end { start + std::min(length, location.dataSize - offset) };
+    std::size_t position { start };
+    while (position < end) {
+        const std::size_t blockIndex { position / SAMPLE_BLOCK_SIZE };
+        SampleCacheShard& shard { archive.shards[blockIndex % archive.shards.size()] };
+
+        //copied out while the shard is locked, as the block can be evicted as soon as it's unlocked
+        const std::lock_guard<std::mutex> lock { shard.mutex };
+        const CachedBlock& block { getCachedBlock(archive, shard, blockIndex) };
+        const std::size_t blockOffset { position - blockIndex * SAMPLE_BLOCK_SIZE };
+        if (blockOffset >= block.data.size()) {
+            //the archive is shorter than it was when it was opened
+            break;
+        }
+        const std::size_t copyCount { std::min(end - position, block.data.size() - blockOffset) };
+        std::memcpy(buffer + (position - start), block.data.data() + blockOffset, copyCount);
+        position += copyCount;
+    }
+    return position - start;
+}
+
+std::optional<std::vector<unsigned char>> readSampleRange(
+    SampleArchive& archive,
+    const std::string_view name,
+    const std::size_t offset,
+    const std::size_t length) {
+
+    const std::optional<std::size_t> dataSize { sampleDataSize(archive, name) };
+    if (!dataSize) {
+        return std::nullopt;
+    }
+
+    std::vector<unsigned char> data(offset < *dataSize ? std::min(length, *dataSize - offset) : 0);
+    const std::optional<std::size_t> numRead { readSampleRange(archive, name, offset, data.size(), data.data()) };
+    data.resize(numRead.value_or(0));
+    return data;
+}
+
+SampleCacheStats sampleCacheStats(SampleArchive& archive) {
+    SampleCacheStats stats {};
+    for (SampleCacheShard& shard : archive.shards) {
+        const std::lock_guard<std::mutex> lock { shard.mutex };
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        for (const CachedBlock& block : shard.blocks) {
+            stats.cachedBytes += block.data.size();
+        }
+    }
+    return stats;
+}
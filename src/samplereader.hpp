@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SAMPLEREADER_H
+#define SAMPLEREADER_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <list>
+#include <unordered_map>
+#include <optional>
+#include <functional>
+#include <mutex>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+//Reads arbitrary byte ranges of the audio data of FSBs in a PCSSB, for tools that
+//preview or scrub through samples without extracting them.
+//
+//The archive is read in SAMPLE_BLOCK_SIZE blocks which are kept in a least recently
+//used cache, so reading the same part of a sample again is served from memory.
+//The cache is split into shards (a block goes to shard blockIndex % shardCount), each
+//with its own lock and file handle, so many threads can read from one archive at once.
+
+//size of the blocks the archive is read and cached in
+constexpr std::size_t SAMPLE_BLOCK_SIZE { 64 * 1024 };
+
+//memory used for cached blocks if no cache size is given
+constexpr std::size_t SAMPLE_CACHE_DEFAULT_SIZE { 32 * 1024 * 1024 };
+
+//number of independently locked parts of the cache
+constexpr std::size_t SAMPLE_CACHE_SHARD_COUNT { 16 };
+
+//where the audio data of an FSB is in the archive
+struct SampleLocation {
+    std::size_t dataPosition {}; // absolute position of the first byte of audio data
+    std::size_t dataSize {}; // cut short if the archive ends before the data does
+};
+
+//a block of the archive held in the cache
+struct CachedBlock {
+    std::size_t blockIndex {}; // position in the archive / SAMPLE_BLOCK_SIZE
+    std::vector<unsigned char> data {}; // shorter than SAMPLE_BLOCK_SIZE at the end of the archive
+};
+
+//one independently locked part of the cache.
+//NOTE: only use the members with mutex locked.
+struct SampleCacheShard {
+    std::mutex mutex {};
+    std::FILE *fileHandle { nullptr };
+    std::size_t capacity {}; // maximum number of blocks
+    std::list<CachedBlock> blocks {}; // most recently used first
+    std::unordered_map<std::size_t, std::list<CachedBlock>::iterator> blockLookup {};
+    std::uint64_t hits {};
+    std::uint64_t misses {};
+};
+
+//an open PCSSB with an index of its FSBs by name and a cache of its blocks.
+//readSampleRange can be called on the same archive from any number of threads at once.
+struct SampleArchive {
+    std::string filePath {};
+    std::size_t fileSize {};
+    //only the first FSB with each name is indexed, like in replace mode
+    std::map<std::string, SampleLocation, std::less<>> samples {};
+    std::vector<SampleCacheShard> shards {};
+};
+
+//how well the cache of an archive has been working
+struct SampleCacheStats {
+    std::uint64_t hits {}; // blocks that were already cached when needed
+    std::uint64_t misses {}; // blocks that had to be read from the archive
+    std::size_t cachedBytes {};
+};
+
+//indexes the FSBs in the PCSSB at filePath and opens it for reading samples,
+//with up to cacheSize bytes of blocks cached (at least one block per shard).
+//logs the error and exits if the file can't be opened.
+//NOTE: the archive has to be closed with closeSampleArchive after you're done using it.
+SampleArchive openSampleArchive(const std::string& filePath, std::size_t cacheSize = SAMPLE_CACHE_DEFAULT_SIZE);
+
+//closes the archive's file handles and frees its cache.
+//it can't be in use by any other thread when this is called.
+void closeSampleArchive(SampleArchive& archive);
+
+//the size of the audio data of the FSB called name.
+//returns nothing if there's no FSB with that name in the archive.
+std::optional<std::size_t> sampleDataSize(const SampleArchive& archive, std::string_view name);
+
+//copies up to length bytes of the audio data of the FSB called name, starting offset
+//bytes into it, into buffer. returns the number of bytes copied, which is less than
+//length if the end of the data is reached (0 if offset is past it), or nothing if
+//there's no FSB with that name in the archive.
+std::optional<std::size_t> readSampleRange(
+    SampleArchive& archive,
+    std::string_view name,
+    std::size_t offset,
+    std::size_t length,
+    unsigned char *buffer);
+
+//same as above, but returns the bytes that were read.
+std::optional<std::vector<unsigned char>> readSampleRange(
+    SampleArchive& archive,
+    std::string_view name,
+    std::size_t offset,
+    std::size_t length);
+
+//the cache hits and misses of the archive so far, and how much of it is in use.
+SampleCacheStats sampleCacheStats(SampleArchive& archive);
+
+#endif
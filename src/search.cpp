@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "search.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <cassert>
+#include <cstdio>
+
+#include "pcssb.hpp"
+#include "parallel.hpp"
+
+bool matchesGlob(const std::string_view pattern, const std::string_view text) {
+    std::size_t patternIndex { 0 };
+    std::size_t textIndex { 0 };
+    //position of the last '*' seen and the text position it was tried at,
+    //so that on a mismatch the '*' can be made to match one more character
+    std::size_t starIndex { std::string_view::npos };
+    std::size_t starTextIndex { 0 };
+
+    while (textIndex < text.size()) {
+        if (patternIndex < pattern.size()
+            && (pattern[patternIndex] == '?' || pattern[patternIndex] == text[textIndex])) {
+            patternIndex++;
+            textIndex++;
+        }
+        else if (patternIndex < pattern.size() && pattern[patternIndex] == '*') {
+            starIndex = patternIndex++;
+            starTextIndex = textIndex;
+        }
+        else if (starIndex != std::string_view::npos) {
+            patternIndex = starIndex + 1;
+            textIndex = ++starTextIndex;
+        }
+        else {
+            return false;
+        }
+    }
+    //any trailing '*'s can match nothing
+    while (patternIndex < pattern.size() && pattern[patternIndex] == '*') {
+        patternIndex++;
+    }
+    return patternIndex == pattern.size();
+}
+
+std::size_t findInDirectory(
+    const std::string& directory,
+    const std::string_view pattern,
+    const bool firstOnly) {
+
+    assert(!directory.empty());
+
+    const std::vector<std::string> archivePaths { findPCSSBFiles(directory) };
+
+    std::atomic<bool> stop { false };
+    std::atomic<std::size_t> matchCount { 0 };
+    std::mutex outputMutex {};
+
+    parallelFor(archivePaths.size(), [&](const std::size_t i) {
+        if (stop) {
+            return;
+        }
+        forEachFSBEntry(archivePaths[i], [&](const FSBEntry& entry) {
+            if (stop) {
+                return false;
+            }
+            if (!matchesGlob(pattern, entry.header.fileName.data())) {
+                return true;
+            }
+
+            const std::lock_guard<std::mutex> lock { outputMutex };
+            //another thread could have printed the first match while this one waited
+            if (firstOnly && stop) {
+                return false;
+            }
+            std::printf("%s: Offset (hexadecimal) = 0x%zX, FSB File Name %s, FSB Data Size = %lu\n",
+                archivePaths[i].c_str(),
+                entry.headerPosition,
+                entry.header.fileName.data(),
+                static_cast<unsigned long>(entry.header.dataSize));
+            //matches are shown straight away rather than when the search ends
+            (void) std::fflush(stdout);
+            matchCount++;
+            if (firstOnly) {
+                stop = true;
+                return false;
+            }
+            return true;
+        });
+    });
+
+    return matchCount;
+}
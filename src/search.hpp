@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+#include <string>
+#include <string_view>
+
+#include <cstddef>
+
+//checks whether text matches a shell style wildcard pattern, where
+//'*' matches any number of characters and '?' matches exactly one.
+//matching is case-sensitive. a pattern without wildcards has to match exactly.
+bool matchesGlob(std::string_view pattern, std::string_view text);
+
+//searches every PCSSB under directory (in parallel) for FSBs with a file name
+//matching the wildcard pattern, printing each match as soon as it is found.
+//only the FSB headers are read, not the audio data.
+//if firstOnly is true the search stops after the first match.
+//returns the number of matches that were printed.
+std::size_t findInDirectory(
+    const std::string& directory,
+    std::string_view pattern,
+    bool firstOnly);
+
+#endif
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "shard.hpp"
+
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <numeric>
+#include <charconv>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "myIO.hpp"
+#include "analysis.hpp"
+
+//archives that are split between shards are split into pieces of about this
+//fraction of a shard's fair share, so the pieces can still be balanced
+constexpr std::uint64_t SHARD_PIECES_PER_SHARE { 4 };
+
+std::optional<ShardSpec> parseShardSpec(const std::string_view text) {
+    const std::size_t slash { text.find('/') };
+    if (slash == std::string_view::npos) {
+        return std::nullopt;
+    }
+
+    ShardSpec shard {};
+    const char *const indexEnd { text.data() + slash };
+    const char *const countEnd { text.data() + text.size() };
+    const std::from_chars_result indexResult { std::from_chars(text.data(), indexEnd, shard.index) };
+    const std::from_chars_result countResult { std::from_chars(indexEnd + 1, countEnd, shard.count) };
+    if (indexResult.ec != std::errc {} || indexResult.ptr != indexEnd
+        || countResult.ec != std::errc {} || countResult.ptr != countEnd
+        || shard.index < 1 || shard.index > shard.count) {
+        return std::nullopt;
+    }
+    return shard;
+}
+
+std::vector<std::vector<ShardUnit>> planShards(
+    const std::vector<std::string>& archivePaths,
+    const std::size_t shardCount,
+    const bool splitArchives) {
+
+    assert(shardCount > 0);
+
+    std::vector<std::uint64_t> archiveSizes {};
+    archiveSizes.reserve(archivePaths.size());
+    for (const std::string& archivePath : archivePaths) {
+        archiveSizes.push_back(std::filesystem::file_size(archivePath));
+    }
+    const std::uint64_t totalSize { std::accumulate(archiveSizes.begin(), archiveSizes.end(), std::uint64_t { 0 }) };
+    const std::uint64_t shareSize { (totalSize + shardCount - 1) / shardCount };
+    const std::uint64_t pieceSize { std::max<std::uint64_t>(1, shareSize / SHARD_PIECES_PER_SHARE) };
+
+    std::vector<ShardUnit> units {};
+    for (std::size_t a = 0; a < archivePaths.size(); a++) {
+        if (!splitArchives || shardCount == 1 || archiveSizes[a] <= shareSize) {
+            units.push_back({ archivePaths[a], 0, 0, true, archiveSizes[a] });
+            continue;
+        }
+
+        //too big for one shard, so split it into consecutive ranges of FSBs
+        const std::vector<FSBEntry> entries { readFSBEntries(archivePaths[a]) };
+        std::size_t firstEntry { 0 };
+        std::uint64_t pieceBytes { 0 };
+        for (std::size_t e = 0; e < entries.size(); e++) {
+            pieceBytes += FSB_HEADER_SIZE + entries[e].header.dataSize;
+            if (pieceBytes >= pieceSize || e + 1 == entries.size()) {
+                units.push_back({ archivePaths[a], firstEntry, e + 1 - firstEntry, false, pieceBytes });
+                firstEntry = e + 1;
+                pieceBytes = 0;
+            }
+        }
+        if (entries.empty()) {
+            units.push_back({ archivePaths[a], 0, 0, true, archiveSizes[a] });
+        }
+    }
+
+    //biggest units first, each going to the shard with the fewest bytes so far.
+    //ties are broken by path and position so the plan is always the same
+    std::vector<std::size_t> order(units.size());
+    std::iota(order.begin(), order.end(), std::size_t { 0 });
+    std::sort(order.begin(), order.end(), [&units](const std::size_t left, const std::size_t right) {
+        if (units[left].byteSize != units[right].byteSize) {
+            return units[left].byteSize > units[right].byteSize;
+        }
+        if (units[left].archivePath != units[right].archivePath) {
+            return units[left].archivePath < units[right].archivePath;
+        }
+        return units[left].firstEntry < units[right].firstEntry;
+    });
+
+    std::vector<std::vector<ShardUnit>> shards(shardCount);
+    std::vector<std::uint64_t> shardSizes(shardCount, 0);
+    for (const std::size_t u : order) {
+        const auto smallest { std::min_element(shardSizes.begin(), shardSizes.end()) };
+        *smallest += units[u].byteSize;
+        shards[static_cast<std::size_t>(smallest - shardSizes.begin())].push_back(units[u]);
+    }
+
+    for (std::vector<ShardUnit>& shardUnits : shards) {
+        std::sort(shardUnits.begin(), shardUnits.end(), [](const ShardUnit& left, const ShardUnit& right) {
+            if (left.archivePath != right.archivePath) {
+                return left.archivePath < right.archivePath;
+            }
+            return left.firstEntry < right.firstEntry;
+        });
+    }
+    return shards;
+}
+
+void extractShard(
+    const std::string& inputPath,
+    const ShardSpec shard,
+    const bool writeManifest,
+    const std::string_view outputDirectory,
+    const OutputFormat format,
+    const bool durable,
+    const NameFilter& filter,
+    std::vector<AudioAnalysis> *const analyses,
+    const PipelineConfig& pipeline) {
+
+    assert(!inputPath.empty());
+    assert(shard.index >= 1 && shard.index <= shard.count);
+
+    const bool isDirectory { std::filesystem::is_directory(inputPath) };
+    const std::vector<std::string> archivePaths { isDirectory
+        ? findPCSSBFiles(inputPath) : std::vector<std::string> { inputPath } };
+
+    //bundles are written one per archive, so archives aren't split between shards for them
+    const std::vector<std::vector<ShardUnit>> plan {
+        planShards(archivePaths, shard.count, format != OutputFormat::bundle) };
+    const std::vector<ShardUnit>& units { plan[shard.index - 1] };
+
+    std::uint64_t shardBytes { 0 };
+    std::uint64_t totalBytes { 0 };
+    for (std::size_t s = 0; s < plan.size(); s++) {
+        for (const ShardUnit& unit : plan[s]) {
+            totalBytes += unit.byteSize;
+            if (s == shard.index - 1) {
+                shardBytes += unit.byteSize;
+            }
+        }
+    }
+    if (writeManifest) {
+        std::cout << "INFO: Shard " << shard.index << '/' << shard.count << " has " << units.size()
+            << " archive(s) or ranges of FSBs from " << archivePaths.size() << " archive(s), "
+            << shardBytes << " of " << totalBytes << " bytes.\n";
+    }
+
+    std::filesystem::create_directories(outputDirectory);
+    char manifestName[64] {};
+    (void) std::snprintf(manifestName, sizeof(manifestName), "shard-%zu-of-%zu.tsv", shard.index, shard.count);
+    const std::string manifestPath { (std::filesystem::path { outputDirectory } / manifestName).string() };
+
+    std::FILE *const manifestHandle { writeManifest ? MyIO::fopen(manifestPath.c_str(), "w") : nullptr };
+    if (manifestHandle != nullptr) {
+        (void) std::fprintf(manifestHandle, "# sm3tools shard %zu/%zu\n# archive\tfsb\theader_offset\tdata_size\n",
+            shard.index, shard.count);
+    }
+    std::size_t fsbCount { 0 };
+    for (const ShardUnit& unit : units) {
+        std::vector<FSBEntry> entries { readFSBEntries(unit.archivePath) };
+        if (!unit.wholeArchive) {
+            const std::size_t first { std::min(unit.firstEntry, entries.size()) };
+            const std::size_t last { std::min(unit.firstEntry + unit.entryCount, entries.size()) };
+            entries = std::vector<FSBEntry>(entries.begin() + static_cast<std::ptrdiff_t>(first),
+                entries.begin() + static_cast<std::ptrdiff_t>(last));
+        }
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [&filter](const FSBEntry& entry) {
+            return !matchesNameFilter(filter, entry.header.fileName.data());
+        }), entries.end());
+
+        //the folders the archives are in are kept, so archives with the same name don't clash
+        const std::filesystem::path relativePath { isDirectory
+            ? std::filesystem::path { unit.archivePath }.lexically_relative(inputPath)
+            : std::filesystem::path { unit.archivePath }.filename() };
+        const std::filesystem::path archiveOutputDirectory { std::filesystem::path { outputDirectory }
+            / relativePath.parent_path() };
+
+        std::vector<AudioAnalysis> unitAnalyses {};
+        outputAudioFiles(unit.archivePath, entries, archiveOutputDirectory.string(), format, durable,
+            analyses != nullptr ? &unitAnalyses : nullptr, pipeline);
+        if (analyses != nullptr) {
+            analyses->insert(analyses->end(), unitAnalyses.begin(), unitAnalyses.end());
+        }
+
+        for (const FSBEntry& entry : entries) {
+            if (manifestHandle != nullptr) {
+                (void) std::fprintf(manifestHandle, "%s\t%s\t%zu\t%lu\n",
+                    relativePath.generic_string().c_str(),
+                    entry.header.fileName.data(),
+                    entry.headerPosition,
+                    static_cast<unsigned long>(entry.header.dataSize));
+            }
+        }
+        fsbCount += entries.size();
+    }
+
+    if (manifestHandle == nullptr) {
+        std::cout << "INFO: Extracted " << fsbCount << " FSBs.\n";
+        return;
+    }
+    (void) std::fflush(manifestHandle);
+    if (std::ferror(manifestHandle)) {
+        std::perror("ERROR: Failed to write shard manifest");
+        std::exit(EXIT_FAILURE);
+    }
+    (void) std::fclose(manifestHandle);
+
+    std::cout << "INFO: Extracted " << fsbCount << " FSBs, manifest written to " << manifestPath << '\n';
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHARD_H
+#define SHARD_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "pcssb.hpp"
+
+//one of the parts that batch work is split into, passed as --shard <index>/<count>
+struct ShardSpec {
+    std::size_t index {}; // starts from 1
+    std::size_t count {};
+};
+
+//a piece of work given to a shard: a range of the FSBs in an archive
+//(all of them unless the archive was too big for one shard)
+struct ShardUnit {
+    std::string archivePath {};
+    std::size_t firstEntry {}; // index into readFSBEntries(archivePath)
+    std::size_t entryCount {};
+    bool wholeArchive {};
+    std::uint64_t byteSize {}; // used for balancing
+};
+
+//parses "<index>/<count>", e.g. "2/8". returns nothing if it isn't valid
+//(the index has to be between 1 and count).
+std::optional<ShardSpec> parseShardSpec(std::string_view text);
+
+//splits the archives between shardCount shards, balancing the number of bytes each gets.
+//archives that are bigger than a fair share are split into ranges of FSBs (unless splitArchives
+//is false). the plan only depends on the archive paths and contents, so every node that makes
+//it for the same files gets the same one. returns the units of each shard, in path order.
+std::vector<std::vector<ShardUnit>> planShards(
+    const std::vector<std::string>& archivePaths,
+    std::size_t shardCount,
+    bool splitArchives);
+
+//extracts the audio of one shard's share of the PCSSBs under inputPath (a directory,
+//or a single archive whose FSBs are split between the shards) into outputDirectory,
+//keeping the folder structure of inputPath.
+//if writeManifest is true (the input was split with --shard), a manifest of every FSB
+//written by this shard is written to <outputDirectory>/shard-<index>-of-<count>.tsv.
+//the manifests of all of the shards can be concatenated to get one for the whole input.
+//if analyses isn't null the extracted audio is analysed into it, and each archive is
+//extracted with the given pipeline, see outputAudioFiles.
+void extractShard(
+    const std::string& inputPath,
+    ShardSpec shard,
+    bool writeManifest,
+    std::string_view outputDirectory,
+    OutputFormat format,
+    bool durable,
+    const NameFilter& filter,
+    std::vector<AudioAnalysis> *analyses,
+    const PipelineConfig& pipeline = {});
+
+#endif
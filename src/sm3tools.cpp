@@ -23,11 +23,23 @@
 #include <filesystem>
 #include <vector>
 #include <sstream>
+#include <utility>
+#include <charconv>
+#include <iomanip>
 
 #include <cassert>
 #include <cstdlib>
+#include <cstdio>
 
 #include "pcssb.hpp"
+#include "catalog.hpp"
+#include "watch.hpp"
+#include "search.hpp"
+#include "modpack.hpp"
+#include "myIO.hpp"
+#include "filter.hpp"
+#include "analysis.hpp"
+#include "shard.hpp"
 
 FileType getFileType(const std::string_view filePath) {
     const std::string fileExtension { std::filesystem::path(filePath).extension().string() };
@@ -98,6 +110,21 @@ std::string getFlagValue(const std::vector<std::string>& args,
     return std::string {};
 }
 
+std::vector<std::string> getFlagValues(const std::vector<std::string>& args,
+    const std::string_view flagName,
+    const std::string_view flagAltName) {
+
+    assert(!args.empty());
+
+    std::vector<std::string> values {};
+    for (size_t i = 1; (i + 1) < args.size(); i++) {
+        if (args[i] == flagName || args[i] == flagAltName) {
+            values.push_back(args[i+1]);
+        }
+    }
+    return values;
+}
+
 std::string getArgOrFlagValue(const std::vector<std::string>& args,
     const std::string_view flagName,
     const std::string_view flagAltName,
@@ -125,25 +152,70 @@ Options parseFlags(const std::vector<std::string>& args) {
     const std::string inputFilePath { getArgOrFlagValue(args, "--input", "-i", 1) };
     const std::string replaceFilePath { getArgOrFlagValue(args, "--replace", "-r", 2)};
     const std::string outputPath { getFlagValue(args, "--out", "-o") };
-
-    return { help, list, verbose, overwrite, inputFilePath, replaceFilePath, outputPath };
+    const std::string buildCatalogDirectory { getFlagValue(args, "--build-catalog", "-bc") };
+    const std::string lookupName { getFlagValue(args, "--lookup", "-lu") };
+    const std::string whichFilePath { getFlagValue(args, "--which", "-wh") };
+    const std::string catalogPath { getFlagValue(args, "--catalog", "-c") };
+    const std::string format { getFlagValue(args, "--format", "-f") };
+    const std::string watchDirectory { getFlagValue(args, "--watch", "-w") };
+    const std::string findPattern { getFlagValue(args, "--find", "-fd") };
+    const std::string searchDirectory { getFlagValue(args, "--directory", "-d") };
+    const bool first { checkFlagPresent(args, "--first", "-1") };
+    const bool durable { checkFlagPresent(args, "--durable", "-du") };
+    const std::string installPackPath { getFlagValue(args, "--install-pack", "-ip") };
+    std::vector<std::string> includePatterns { getFlagValues(args, "--include", "-in") };
+    std::vector<std::string> excludePatterns { getFlagValues(args, "--exclude", "-ex") };
+    std::vector<std::string> regexPatterns { getFlagValues(args, "--regex", "-re") };
+    const std::string nameListPath { getFlagValue(args, "--names", "-nl") };
+    const std::string analysisReportPath { getFlagValue(args, "--analyse", "-an") };
+    const std::string shard { getFlagValue(args, "--shard", "-sh") };
+    const std::string decodeThreads { getFlagValue(args, "--decode-threads", "-dt") };
+    const std::string writeThreads { getFlagValue(args, "--write-threads", "-wt") };
+    const std::string queueDepth { getFlagValue(args, "--queue-depth", "-qd") };
+    const std::string repackAlignment { getFlagValue(args, "--repack", "-rp") };
+
+    return { help, list, verbose, overwrite, inputFilePath, replaceFilePath, outputPath,
+        buildCatalogDirectory, lookupName, whichFilePath, catalogPath, format, watchDirectory,
+        findPattern, searchDirectory, first, durable, installPackPath,
+        std::move(includePatterns), std::move(excludePatterns), std::move(regexPatterns),
+        nameListPath, analysisReportPath, shard, decodeThreads, writeThreads, queueDepth,
+        repackAlignment };
 }
 
 void printHelp() {
     constexpr std::string_view USAGE_TEXT {
         "Usage (1): sm3tools.exe <Input PCSSB File> --list\n"
-        "Usage (2): sm3tools.exe <Input PCSSB File> --out <Output Directory>\n"
+        "Usage (2): sm3tools.exe <Input PCSSB File or Directory> --out <Output Directory> [--shard <i>/<n>]\n"
         "Usage (3): sm3tools.exe <Input PCSSB File> --replace <Audio File To Replace> "
             "--out <Output Directory>\n"
+        "Usage (4): sm3tools.exe <Input PCSSB File> --watch <Directory> --out <Output File>\n"
+        "Usage (5): sm3tools.exe --build-catalog <Directory> [--catalog <Catalog File>]\n"
+        "Usage (6): sm3tools.exe --lookup <FSB File Name> [--catalog <Catalog File>]\n"
+        "Usage (7): sm3tools.exe --find <FSB File Name or Pattern> [--directory <Directory>] [--first]\n"
+        "Usage (8): sm3tools.exe --install-pack <Manifest File>\n"
+        "Usage (9): sm3tools.exe <Input PCSSB File> --repack <Alignment> [--out <Output File>]\n"
+        "Usage (10): sm3tools.exe --which <Extracted File> [--catalog <Catalog File>]\n"
         "(1) Prints out a listing of all the FSB files found within the PCSSB\n"
-        "(2) Outputs all audio files from the PCSSB into the output directory\n"
+        "(2) Outputs all audio files from the PCSSB (or every PCSSB in the directory) into the output directory\n"
         "(3) Injects the specified audio file into the PCSSB file, replacing "
-            "it in the FSB with the same filename\n" };
+            "it in the FSB with the same filename\n"
+        "(4) Watches the directory, injecting audio files into the PCSSB whenever they change\n"
+        "(5) Indexes every PCSSB in the directory into a catalog file. "
+            "Only archives that changed since the last build are read again\n"
+        "(6) Prints which archives contain an FSB with the given file name, using the catalog\n"
+        "(7) Searches every PCSSB in the directory for FSBs with a matching file name "
+            "(* and ? can be used as wildcards)\n"
+        "(8) Injects every audio file listed in the manifest into its PCSSB, "
+            "either changing all of the archives or none of them\n"
+        "(9) Rewrites the PCSSB with every FSB starting on a multiple of the alignment in bytes "
+            "(e.g. 2048 or 4096)\n"
+        "(10) Prints which FSBs in the catalog the file was extracted from, by comparing its contents\n" };
 
     constexpr std::string_view FLAGS_TEXT {
         "FLAGS\n"
         //indented with four spaces
         "   -i <arg> | --input <arg> - Recommended way to pass the path to an input file\n"
+        "       Pass - to read a PCSSB from standard input (list and extract only)\n"
         "   -r <arg> | --replace <arg> - Recommended way to pass the path to a "
             "file to replace within the input file\n"
         "   -o <arg> | --replace <arg> - Pass the path to the output directory \n"
@@ -151,6 +223,39 @@ void printHelp() {
         "   -oi | --overwrite-input - Overwrites the input file (only works in replace mode)\n"
         "   -v | --verbose - Increase verbosity (currently unused)\n"
         "   -l | --list` - List files in archive\n"
+        "   -f <arg> | --format <arg> - Format to extract audio in, either raw (default), wav or bundle.\n"
+        "       wav converts PCM and IMA ADPCM audio into PCM WAV files,\n"
+        "       bundle writes all audio into one indexed .sm3bundle file\n"
+        "   -du | --durable - Flush extracted files to disk before exiting\n"
+        "   -in <arg> | --include <arg> - Only extract FSBs with names matching a wildcard pattern\n"
+        "   -ex <arg> | --exclude <arg> - Don't extract FSBs with names matching a wildcard pattern\n"
+        "   -re <arg> | --regex <arg> - Only extract FSBs with names matching a regular expression\n"
+        "   -nl <arg> | --names <arg> - Only extract FSBs named in a file (one name per line)\n"
+        "       --include, --exclude and --regex can be passed more than once. An FSB is extracted if it\n"
+        "       matches any include, regex or name (or none are given) and no exclude\n"
+        "   -sh <arg> | --shard <arg> - Only do part <index>/<count> of the extraction, e.g. 2/8.\n"
+        "       Archives (or FSBs in very large ones) are shared out between the parts by size,\n"
+        "       and each part writes a shard-<index>-of-<count>.tsv manifest of what it extracted\n"
+        "   -dt <arg> | --decode-threads <arg> - Number of threads reading and converting audio while extracting\n"
+        "       (defaults to one per CPU thread)\n"
+        "   -wt <arg> | --write-threads <arg> - Number of threads writing extracted files (defaults to 2)\n"
+        "   -qd <arg> | --queue-depth <arg> - Number of FSBs (or pieces of them) that can wait to be converted or written (defaults to 16).\n"
+        "       Lower values use less memory\n"
+        "   -an <arg> | --analyse <arg> - Measure the peak, RMS, DC offset, silence and clipping of PCM audio\n"
+        "       while extracting it, and write a report to the file (JSON if it ends in .json, CSV otherwise)\n"
+        "   -rp <arg> | --repack <arg> - Rewrite the PCSSB with each FSB aligned to this many bytes\n"
+        "       (a power of two, e.g. 2048 or 4096), reporting how much padding that adds.\n"
+        "       The data before the first FSB isn't updated, so the output may not work in game\n"
+        "   -w <arg> | --watch <arg> - Watch a directory of replacement audio files (Linux only)\n"
+        "   -bc <arg> | --build-catalog <arg> - Index every PCSSB in a directory into the catalog\n"
+        "   -lu <arg> | --lookup <arg> - Find which archives contain an FSB file name\n"
+        "   -wh <arg> | --which <arg> - Find which FSBs have the same contents as an extracted file\n"
+        "       (raw or WAV), even if it has been renamed\n"
+        "   -c <arg> | --catalog <arg> - Path to the catalog file (defaults to ./sm3tools.catalog)\n"
+        "   -fd <arg> | --find <arg> - Search archives for an FSB file name or wildcard pattern\n"
+        "   -d <arg> | --directory <arg> - Directory to search in (defaults to the current directory)\n"
+        "   -1 | --first - Stop searching after the first match\n"
+        "   -ip <arg> | --install-pack <arg> - Install a mod pack manifest (lines of <PCSSB>\\t<Audio File>)\n"
     };
 
     std::cout << USAGE_TEXT << '\n';
@@ -179,11 +284,149 @@ std::string tempFileOutPath(const std::string& inputFilePath) {
     return strStream.str();
 }
 
+std::optional<OutputFormat> parseOutputFormat(const std::string_view format) {
+    if (format.empty() || format == "raw") return OutputFormat::raw;
+    if (format == "wav") return OutputFormat::wav;
+    if (format == "bundle") return OutputFormat::bundle;
+    return std::nullopt;
+}
+
+NameFilter buildNameFilter(const Options& options) {
+    NameFilter filter {};
+    filter.includePatterns = options.includePatterns;
+    filter.excludePatterns = options.excludePatterns;
+    for (const std::string& pattern : options.regexPatterns) {
+        filter.regexes.push_back(compileNameRegex(pattern));
+    }
+    if (!options.nameListPath.empty()) {
+        readNameList(options.nameListPath, filter.names);
+    }
+    return filter;
+}
+
+//parses the value of a flag that takes a count into count (leaving it alone if the flag
+//wasn't passed), logging the error and exiting if it isn't a whole number above 0
+static void parseCountFlag(const std::string& value, const std::string_view flagName, std::size_t& count) {
+    if (value.empty()) {
+        return;
+    }
+    std::size_t parsed { 0 };
+    const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), parsed);
+    if (error != std::errc {} || end != value.data() + value.size() || parsed == 0) {
+        std::cerr << "ERROR: Invalid value " << value << " for " << flagName
+            << ", expected a whole number above 0.\n";
+        std::exit(EXIT_FAILURE);
+    }
+    count = parsed;
+}
+
+PipelineConfig buildPipelineConfig(const Options& options) {
+    PipelineConfig pipeline {};
+    parseCountFlag(options.decodeThreads, "--decode-threads", pipeline.decodeThreads);
+    parseCountFlag(options.writeThreads, "--write-threads", pipeline.writeThreads);
+    parseCountFlag(options.queueDepth, "--queue-depth", pipeline.queueDepth);
+    return pipeline;
+}
+
+void extractMain(const Options& options, std::FILE *const inputStream) {
+    const std::optional<OutputFormat> format { parseOutputFormat(options.format) };
+    if (!format) {
+        std::cerr << "ERROR: Unknown output format " << options.format << ".\n";
+        std::exit(EXIT_FAILURE);
+    }
+    const NameFilter filter { buildNameFilter(options) };
+    const PipelineConfig pipeline { buildPipelineConfig(options) };
+    const std::string outputDirectory { options.outputPath.empty() ? "./out" : options.outputPath };
+
+    std::vector<AudioAnalysis> analyses {};
+    std::vector<AudioAnalysis> *const analysesOut { options.analysisReportPath.empty() ? nullptr : &analyses };
+    if (inputStream != nullptr) {
+        std::cout << "INFO: Extracting audio from standard input\n";
+        outputAudioFiles(inputStream, STDIN_OUTPUT_NAME, outputDirectory,
+            *format, options.durable, filter, analysesOut);
+    }
+    else if (!options.shard.empty() || std::filesystem::is_directory(options.inputFilePath)) {
+        const std::optional<ShardSpec> shard { options.shard.empty()
+            ? ShardSpec { 1, 1 } : parseShardSpec(options.shard) };
+        if (!shard) {
+            std::cerr << "ERROR: Invalid shard " << options.shard
+                << ", expected <index>/<count> with an index from 1 to count.\n";
+            std::exit(EXIT_FAILURE);
+        }
+        std::cout << "INFO: Extracting audio from " << options.inputFilePath << '\n';
+        //a plain directory extract is done as the only shard, without a manifest
+        extractShard(options.inputFilePath, *shard, !options.shard.empty(), outputDirectory,
+            *format, options.durable, filter, analysesOut, pipeline);
+    }
+    else {
+        std::cout << "INFO: Extracting audio from " << options.inputFilePath << '\n';
+        outputAudioFiles(options.inputFilePath, outputDirectory,
+            *format, options.durable, filter, analysesOut, pipeline);
+    }
+
+    if (analysesOut != nullptr) {
+        writeAnalysisReport(analyses, options.analysisReportPath);
+        std::cout << "INFO: Wrote analysis of " << analyses.size() << " FSBs to "
+            << options.analysisReportPath << '\n';
+    }
+}
+
+void repackMain(const Options& options) {
+    std::size_t alignment { 0 };
+    parseCountFlag(options.repackAlignment, "--repack", alignment);
+    if (alignment < 16 || (alignment & (alignment - 1)) != 0) {
+        std::cerr << "ERROR: The repack alignment has to be a power of two of at least 16, not "
+            << options.repackAlignment << ".\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    //the data before the first FSB isn't understood yet and may hold offsets of the FSBs
+    //that repacking moves, so the original is always kept
+    if (options.overwrite) {
+        std::cerr << "ERROR: --repack can't be used with --overwrite-input, "
+            "the repacked file is written to a new file so the original is kept.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    //same output file as replace mode
+    std::string outputFilePath { options.outputPath };
+    if (outputFilePath.empty()) {
+        outputFilePath = defaultModifiedFileOutPath(options.inputFilePath, "./out");
+        std::filesystem::create_directories("./out");
+    }
+
+    std::cout << "INFO: Repacking " << options.inputFilePath << " with FSBs aligned to "
+        << alignment << " bytes\n";
+    const RepackResult result { repackPCSSB(options.inputFilePath, outputFilePath, alignment) };
+
+    const double overhead { result.originalSize == 0 ? 0.0
+        : 100.0 * static_cast<double>(result.paddingSize) / static_cast<double>(result.originalSize) };
+    std::cout << "INFO: Wrote " << result.fsbCount << " FSBs to " << outputFilePath << ": "
+        << result.originalSize << " -> " << result.repackedSize << " bytes, "
+        << result.paddingSize << " bytes of padding (" << std::fixed << std::setprecision(2)
+        << overhead << "% overhead).\n";
+    if (result.paddingSize > 0 && result.leadingSize > 0) {
+        std::cerr << "WARNING: The " << result.leadingSize << " bytes before the first FSB were copied unchanged. "
+            "If the game keeps the offsets or sizes of the FSBs there, the repacked file won't play in game.\n";
+    }
+}
+
 void pcssbMain(const Options& options) {
     if (options.list) {
         std::cout << "INFO: Listing FSBs in " << options.inputFilePath << '\n';
         printFSBList(options.inputFilePath);
     }
+    else if (!options.watchDirectory.empty()) {
+        //NOTE: the output file is patched in place, so with --overwrite-input
+        //the input file itself is changed rather than replaced atomically
+        std::string outputFilePath { options.inputFilePath };
+        if (!options.overwrite) {
+            outputFilePath = options.outputPath.empty()
+                ? defaultModifiedFileOutPath(options.inputFilePath, "./out")
+                : options.outputPath;
+        }
+        watchReplacements(options.inputFilePath, options.watchDirectory, outputFilePath);
+    }
     else if (!options.replaceFilePath.empty()) {
          std::cout << "Replacing " << options.replaceFilePath << " in " << options.inputFilePath << '\n';
          if (options.overwrite) {
@@ -209,15 +452,70 @@ void pcssbMain(const Options& options) {
              replaceAudioinPCSSB(options.inputFilePath, options.replaceFilePath, options.outputPath);
          }
     }
+    else if (!options.repackAlignment.empty()) {
+        repackMain(options);
+    }
     else {
-        std::cout << "INFO: Extracting audio from " << options.inputFilePath << '\n';
-        if (options.outputPath.empty()) {
-            outputAudioFiles(options.inputFilePath, "./out");
+        extractMain(options, nullptr);
+    }
+}
+
+int streamMain(const Options& options) {
+    if (!options.shard.empty()) {
+        std::cerr << "ERROR: Standard input can't be split into shards.\n";
+        return EXIT_FAILURE;
+    }
+    if (!options.replaceFilePath.empty() || !options.watchDirectory.empty() || !options.repackAlignment.empty()) {
+        std::cerr << "ERROR: Replacing audio and repacking need a seekable input file, "
+            "standard input can only be listed or extracted.\n";
+        return EXIT_FAILURE;
+    }
+
+    std::FILE *const inputStream { MyIO::openstdin() };
+    if (options.list) {
+        std::cout << "INFO: Listing FSBs in standard input\n";
+        printFSBList(inputStream);
+        return EXIT_SUCCESS;
+    }
+
+    extractMain(options, inputStream);
+    return EXIT_SUCCESS;
+}
+
+int findMain(const Options& options) {
+    const std::string directory { options.searchDirectory.empty() ? "." : options.searchDirectory };
+
+    std::cout << "INFO: Searching " << directory << " for " << options.findPattern << std::endl;
+    if (findInDirectory(directory, options.findPattern, options.first) == 0) {
+        std::cerr << "ERROR: No FSBs matching " << options.findPattern << " were found.\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int catalogMain(const Options& options) {
+    const std::string catalogPath { options.catalogPath.empty()
+        ? std::string { DEFAULT_CATALOG_PATH } : options.catalogPath };
+
+    if (!options.buildCatalogDirectory.empty()) {
+        std::cout << "INFO: Building catalog of " << options.buildCatalogDirectory
+            << " in " << catalogPath << '\n';
+        buildCatalog(options.buildCatalogDirectory, catalogPath);
+    }
+    if (!options.lookupName.empty()) {
+        if (!lookupCatalog(catalogPath, options.lookupName)) {
+            std::cerr << "ERROR: " << options.lookupName << " was not found in the catalog.\n";
+            return EXIT_FAILURE;
         }
-        else {
-            outputAudioFiles(options.inputFilePath, options.outputPath);
+    }
+    if (!options.whichFilePath.empty()) {
+        if (!lookupCatalogContent(catalogPath, options.whichFilePath)) {
+            std::cerr << "ERROR: No FSB in the catalog has the same contents as "
+                << options.whichFilePath << ".\n";
+            return EXIT_FAILURE;
         }
     }
+    return EXIT_SUCCESS;
 }
 
 // Program takes one argument, that being the path to a file to parse.
@@ -241,12 +539,41 @@ int main(const int argc, const char *const argv[]) {
         return EXIT_SUCCESS;
     }
 
+    if (!options.findPattern.empty()) {
+        return findMain(options);
+    }
+
+    if (!options.installPackPath.empty()) {
+        std::cout << "INFO: Installing mod pack " << options.installPackPath << '\n';
+        installModPack(options.installPackPath);
+        return EXIT_SUCCESS;
+    }
+
+    if (!options.buildCatalogDirectory.empty() || !options.lookupName.empty()
+        || !options.whichFilePath.empty()) {
+        return catalogMain(options);
+    }
+
     if (options.inputFilePath.empty()) {
         std::cerr << "ERROR: Program needs an input file argument.\n";
         printHelp();
         return EXIT_FAILURE;
     }
 
+    if (options.inputFilePath == STDIN_INPUT_PATH) {
+        return streamMain(options);
+    }
+
+    if (std::filesystem::is_directory(options.inputFilePath)) {
+        if (options.list || !options.replaceFilePath.empty() || !options.watchDirectory.empty()
+            || !options.repackAlignment.empty()) {
+            std::cerr << "ERROR: A directory can only be used as the input when extracting.\n";
+            return EXIT_FAILURE;
+        }
+        extractMain(options, nullptr);
+        return EXIT_SUCCESS;
+    }
+
     switch (getFileType(options.inputFilePath)) {
         case FileType::none:
             std::cerr << "ERROR: Argument doesn't have a file extension."
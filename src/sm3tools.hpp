@@ -22,6 +22,11 @@
 #include <string_view>
 #include <string>
 #include <vector>
+#include <optional>
+
+#include <cstdio>
+
+#include "pcssb.hpp"
 
 enum class FileType {
     none,
@@ -49,8 +54,38 @@ struct Options {
     // either the output directory (if outputting contents of archive),
     // or the output file path (if modifying an archive)
     std::string outputPath {};
+    std::string buildCatalogDirectory {}; // directory of archives to index into the catalog
+    std::string lookupName {}; // FSB file name to look up in the catalog
+    std::string whichFilePath {}; // path to an extracted file to look up in the catalog by its contents
+    std::string catalogPath {}; // path to the catalog file
+    std::string format {}; // format to extract audio in ("raw", "wav" or "bundle"), raw if empty
+    std::string watchDirectory {}; // directory of replacement files to watch for changes
+    std::string findPattern {}; // FSB file name (or wildcard pattern) to search for
+    std::string searchDirectory {}; // directory of archives to search in
+    bool first { false }; // whether to stop searching after the first match
+    bool durable { false }; // whether extracted files have to be flushed to disk before exiting
+    std::string installPackPath {}; // path to a mod pack manifest to install
+    std::vector<std::string> includePatterns {}; // wildcard patterns of FSB names to extract
+    std::vector<std::string> excludePatterns {}; // wildcard patterns of FSB names not to extract
+    std::vector<std::string> regexPatterns {}; // regular expressions of FSB names to extract
+    std::string nameListPath {}; // path to a file of exact FSB names to extract
+    std::string analysisReportPath {}; // path to write an analysis of the extracted audio to
+    std::string shard {}; // which part of the batch work to do, as "<index>/<count>"
+    std::string decodeThreads {}; // number of threads reading and converting audio when extracting
+    std::string writeThreads {}; // number of threads writing files when extracting
+    std::string queueDepth {}; // number of FSBs that can wait between extraction stages
+    std::string repackAlignment {}; // byte boundary to align each FSB to when repacking
 };
 
+// catalog file used by --build-catalog, --lookup and --which if --catalog isn't passed
+constexpr std::string_view DEFAULT_CATALOG_PATH { "./sm3tools.catalog" };
+
+// input file path meaning "read the PCSSB from standard input"
+constexpr std::string_view STDIN_INPUT_PATH { "-" };
+
+// name of the folder that audio extracted from standard input is written to
+constexpr std::string_view STDIN_OUTPUT_NAME { "stdin" };
+
 //checks if a flag (either flagName or flagAltName) was passed at least once.
 //flagAltName is a parameter so that you can check if either the short
 //or long form of a flag was passed.
@@ -77,6 +112,12 @@ std::string getFlagValue(const std::vector<std::string>& args,
     const std::string_view flagName,
     const std::string_view flagAltName);
 
+//same as getFlagValue, but returns the value passed with every occurrence
+//of the flag (in order), for flags that can be passed more than once.
+std::vector<std::string> getFlagValues(const std::vector<std::string>& args,
+    const std::string_view flagName,
+    const std::string_view flagAltName);
+
 //wrapper function that aims to look for an argument which can be passed either
 //as the value to a flag or as a positional argument (before any flags are passed).
 //first the value to the flag (flagName or flagAltName) is checked, then if not found.
@@ -105,7 +146,44 @@ std::string defaultModifiedFileOutPath(
 // adds ".tmp" onto the end of the file path
 std::string tempFileOutPath(const std::string& inputFilePath);
 
+// converts the value passed with --format into an OutputFormat.
+// an empty value gives the default (raw). returns nothing if the format isn't recognised.
+std::optional<OutputFormat> parseOutputFormat(std::string_view format);
+
+// builds the filter of FSB names to extract from --include, --exclude, --regex and --names.
+// logs the error and exits if a regular expression is invalid or the name list can't be read.
+NameFilter buildNameFilter(const Options& options);
+
+// builds the extraction pipeline settings from --decode-threads, --write-threads and --queue-depth,
+// keeping the defaults for any that weren't passed.
+// logs the error and exits if a value isn't a whole number above 0.
+PipelineConfig buildPipelineConfig(const Options& options);
+
+// extracts audio from the input file (or stream if inputStream isn't null) using the
+// specified program options, writing an analysis report if one was asked for.
+// a directory of PCSSBs (or a file with --shard) is extracted with extractShard.
+void extractMain(const Options& options, std::FILE *inputStream);
+
+// rewrites the input PCSSB with each FSB aligned to --repack bytes, using the same
+// output file rules as replace mode, and reports how much padding was added.
+// warns that the data before the first FSB isn't updated when any FSB was moved.
+// logs the error and exits if the alignment isn't a power of two of at least 16,
+// or if --overwrite-input is given.
+void repackMain(const Options& options);
+
 // performs operations on a PCSSB file using the specified program options
 void pcssbMain(const Options& options);
 
+// lists or extracts a PCSSB read from standard input (--input -) in a single pass.
+// returns the program exit code.
+int streamMain(const Options& options);
+
+// searches a directory of archives using the specified program options.
+// returns the program exit code.
+int findMain(const Options& options);
+
+// builds or looks up the cross-archive catalog using the specified program options.
+// returns the program exit code.
+int catalogMain(const Options& options);
+
 #endif
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "watch.hpp"
+
+#include <iostream>
+#include <filesystem>
+#include <unordered_map>
+#include <set>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "pcssb.hpp"
+#include "myIO.hpp"
+
+//audio that was in the output before each FSB was first replaced, by FSB name
+using OriginalAudio = std::unordered_map<std::string, std::vector<char>>;
+
+//for every changed file that matches an FSB, writes it into the output in one go, or
+//(if the file has been deleted or moved away) puts back the audio the FSB had before
+static void applyChangedFiles(
+    const std::unordered_map<std::string, FSBEntry>& entriesByName,
+    const std::string& watchDirectory,
+    const std::set<std::string>& changedFileNames,
+    const std::string& outputFilePath,
+    OriginalAudio& originalAudio) {
+
+    const auto startTime { std::chrono::steady_clock::now() };
+
+    std::vector<AudioReplacement> replacements {};
+    std::vector<const FSBEntry *> unsavedEntries {};
+    std::vector<const FSBEntry *> restoredEntries {};
+    for (const std::string& fileName : changedFileNames) {
+        const auto entry { entriesByName.find(fileName) };
+        if (entry == entriesByName.end()) {
+            continue;
+        }
+        const std::filesystem::path replaceFilePath { std::filesystem::path { watchDirectory } / fileName };
+        if (std::filesystem::is_regular_file(replaceFilePath)) {
+            replacements.push_back({
+                entry->second.headerPosition + FSB_HEADER_SIZE,
+                entry->second.header.dataSize,
+                replaceFilePath.string() });
+            if (originalAudio.count(fileName) == 0) {
+                unsavedEntries.push_back(&entry->second);
+            }
+        }
+        else if (originalAudio.count(fileName) != 0) {
+            restoredEntries.push_back(&entry->second);
+        }
+    }
+    if (replacements.empty() && restoredEntries.empty()) {
+        return;
+    }
+
+    std::FILE *const outputFileHandle { MyIO::fopen(outputFilePath.c_str(), "r+b") };
+    {
+        //keep what is about to be overwritten for the first time
+        for (const FSBEntry *const entry : unsavedEntries) {
+            std::vector<char> audio(entry->header.dataSize);
+            MyIO::fseekunsigned(outputFileHandle, entry->headerPosition + FSB_HEADER_SIZE, SEEK_SET);
+            audio.resize(MyIO::fread(audio.data(), sizeof(char), audio.size(), outputFileHandle));
+            originalAudio.emplace(entry->header.fileName.data(), std::move(audio));
+        }
+        for (const FSBEntry *const entry : restoredEntries) {
+            const auto original { originalAudio.find(entry->header.fileName.data()) };
+            if (!original->second.empty()) {
+                MyIO::fseekunsigned(outputFileHandle, entry->headerPosition + FSB_HEADER_SIZE, SEEK_SET);
+                (void) MyIO::fwrite(original->second.data(), sizeof(char), original->second.size(), outputFileHandle);
+            }
+            originalAudio.erase(original);
+        }
+    }
+    (void) std::fclose(outputFileHandle);
+
+    const std::size_t numApplied { replacements.empty() ? 0 : applyAudioReplacements(outputFilePath, replacements) };
+
+    const auto elapsed { std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime) };
+    std::cout << "INFO: Replaced " << numApplied << " file(s) and restored " << restoredEntries.size()
+        << " original(s) in " << outputFilePath << " in " << elapsed.count() << " ms." << std::endl;
+}
+
+//adds every file in watchDirectory to changedFileNames, along with every FSB that has been
+//replaced (whose file may have been deleted since), so that all of them are checked again
+static void addEveryFileName(
+    const std::string& watchDirectory,
+    const OriginalAudio& originalAudio,
+    std::set<std::string>& changedFileNames) {
+
+    for (const auto& dirEntry : std::filesystem::directory_iterator(watchDirectory)) {
+        changedFileNames.insert(dirEntry.path().filename().string());
+    }
+    for (const auto& original : originalAudio) {
+        changedFileNames.insert(original.first);
+    }
+}
+
+void watchReplacements(
+    const std::string& pcssbFilePath,
+    const std::string& watchDirectory,
+    const std::string& outputFilePath) {
+
+    assert(!pcssbFilePath.empty());
+    assert(!watchDirectory.empty());
+    assert(!outputFilePath.empty());
+
+#ifdef __linux__
+    //index the archive once, keeping the first FSB with each name
+    //(the same one findFirstFSBMatchingFileName would give)
+    std::unordered_map<std::string, FSBEntry> entriesByName {};
+    for (const FSBEntry& entry : readFSBEntries(pcssbFilePath)) {
+        entriesByName.emplace(entry.header.fileName.data(), entry);
+    }
+
+    const int inotifyFd { ::inotify_init1(IN_CLOEXEC) };
+    if (inotifyFd < 0) {
+        std::perror("ERROR: Failed to start watching for changes");
+        std::exit(EXIT_FAILURE);
+    }
+    //editors often save by writing a new file and renaming it over the old one,
+    //so moves into the directory are watched as well as writes. deletes and moves
+    //out of it are watched so the original audio can be put back
+    if (::inotify_add_watch(inotifyFd, watchDirectory.c_str(),
+        IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM) < 0) {
+        std::perror("ERROR: Failed to watch directory");
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (!std::filesystem::exists(outputFilePath)
+        || !std::filesystem::equivalent(pcssbFilePath, outputFilePath)) {
+        copyFile(pcssbFilePath, outputFilePath);
+    }
+
+    //apply whatever is already in the directory so the output starts up to date
+    OriginalAudio originalAudio {};
+    std::set<std::string> changedFileNames {};
+    addEveryFileName(watchDirectory, originalAudio, changedFileNames);
+    applyChangedFiles(entriesByName, watchDirectory, changedFileNames, outputFilePath, originalAudio);
+    changedFileNames.clear();
+
+    std::cout << "INFO: Watching " << watchDirectory << " for changes to "
+        << entriesByName.size() << " FSB(s). Press Ctrl+C to stop." << std::endl;
+
+    //NOTE: aligned so the inotify_event structs inside can be read in place
+    alignas(struct inotify_event) char buffer[4096];
+    std::chrono::steady_clock::time_point firstChangeTime {};
+    while (true) {
+        //block until something changes, then keep collecting changes until there
+        //has been a quiet period, or until the first change has waited long enough
+        //(so a steady stream of saves still gets written)
+        int timeout { -1 };
+        if (!changedFileNames.empty()) {
+            const auto waited { std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - firstChangeTime).count() };
+            if (waited >= WATCH_MAX_DELAY_MILLISECONDS) {
+                applyChangedFiles(entriesByName, watchDirectory, changedFileNames, outputFilePath, originalAudio);
+                changedFileNames.clear();
+                continue;
+            }
+            timeout = static_cast<int>(std::min<long long>(WATCH_COALESCE_MILLISECONDS,
+                WATCH_MAX_DELAY_MILLISECONDS - waited));
+        }
+
+        pollfd pollFd { inotifyFd, POLLIN, 0 };
+        const int pollResult { ::poll(&pollFd, 1, timeout) };
+        if (pollResult < 0) {
+            std::perror("ERROR: Failed waiting for changes");
+            std::exit(EXIT_FAILURE);
+        }
+        if (pollResult == 0) {
+            applyChangedFiles(entriesByName, watchDirectory, changedFileNames, outputFilePath, originalAudio);
+            changedFileNames.clear();
+            continue;
+        }
+
+        const ssize_t numRead { ::read(inotifyFd, buffer, sizeof(buffer)) };
+        if (numRead <= 0) {
+            std::perror("ERROR: Failed reading changes");
+            std::exit(EXIT_FAILURE);
+        }
+        for (ssize_t offset = 0; offset < numRead;) {
+            const auto *const event { reinterpret_cast<const struct inotify_event *>(buffer + offset) };
+            if (event->mask & IN_IGNORED) {
+                std::cerr << "ERROR: Stopped being able to watch " << watchDirectory
+                    << ", it may have been deleted or moved.\n";
+                std::exit(EXIT_FAILURE);
+            }
+            //too many changes happened at once and some of them were lost,
+            //so every file is checked again like when starting
+            if (event->mask & IN_Q_OVERFLOW) {
+                std::cout << "LOG: Missed some changes to " << watchDirectory << ", checking every file again.\n";
+                if (changedFileNames.empty()) {
+                    firstChangeTime = std::chrono::steady_clock::now();
+                }
+                addEveryFileName(watchDirectory, originalAudio, changedFileNames);
+            }
+            //changes to files that don't match an FSB (swap files, autosaves, ...)
+            //are ignored, so they can't hold back the ones that do
+            else if (event->len > 0 && entriesByName.count(event->name) != 0) {
+                if (changedFileNames.empty()) {
+                    firstChangeTime = std::chrono::steady_clock::now();
+                }
+                changedFileNames.insert(event->name);
+            }
+            offset += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+        }
+    }
+#else
+    std::cerr << "ERROR: Watch mode is only supported on Linux.\n";
+    std::exit(EXIT_FAILURE);
+#endif
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef WATCH_H
+#define WATCH_H
+#include <string>
+
+//how long to wait after a change for further changes before writing,
+//so that a burst of saves (or several files being saved together) is one write
+constexpr int WATCH_COALESCE_MILLISECONDS { 100 };
+//longest a change waits to be written while more changes keep coming in
+constexpr int WATCH_MAX_DELAY_MILLISECONDS { 1000 };
+
+//watches watchDirectory for audio files with the same name as an FSB in the
+//PCSSB at pcssbFilePath, and writes their audio into outputFilePath whenever they
+//are written to or moved into the directory. if one of those files is deleted or moved
+//out of the directory, the audio its FSB had in outputFilePath before it was first
+//replaced (while this was running) is put back.
+//the PCSSB is only indexed once. If outputFilePath is not the PCSSB itself it is
+//first created as a copy of the PCSSB, and any matching files already in the
+//directory are applied straight away.
+//runs until the program is interrupted. only supported on Linux (uses inotify),
+//elsewhere it prints an error and exits.
+void watchReplacements(
+    const std::string& pcssbFilePath,
+    const std::string& watchDirectory,
+    const std::string& outputFilePath);
+
+#endif
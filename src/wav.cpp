@@ -0,0 +1,364 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "wav.hpp"
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SM3TOOLS_SSE2 1
+#endif
+
+#include "myIO.hpp"
+#include "bytes.hpp"
+#include "analysis.hpp"
+
+//number of bytes of FSB audio data that is read and converted at once
+constexpr std::size_t CONVERT_BUFFER_SIZE { 64 * 1024 };
+
+//reads up to count bytes of audio data into buffer, returning the number read
+//(0 once there is no more data)
+using AudioReader = std::function<std::size_t(unsigned char *buffer, std::size_t count)>;
+
+std::uint16_t channelCount(const FSBHeader& header) {
+    if (header.numChannels != 0) {
+        return header.numChannels;
+    }
+    return (header.mode & FSBMode::STEREO) ? 2 : 1;
+}
+
+bool isPCM(const FSBHeader& header) {
+    constexpr std::uint32_t COMPRESSED_MODES {
+        FSBMode::MPEG | FSBMode::IMAADPCM | FSBMode::VAG | FSBMode::XMA | FSBMode::GCADPCM };
+    return (header.mode & COMPRESSED_MODES) == 0
+        && (header.mode & (FSBMode::BITS_8 | FSBMode::BITS_16)) != 0;
+}
+
+bool isWavConvertible(const FSBHeader& header) {
+    return isPCM(header) || (header.mode & FSBMode::IMAADPCM) != 0;
+}
+
+void buildWavHeader(
+    unsigned char *const header,
+    const std::uint16_t numChannels,
+    const std::uint32_t sampleRate,
+    const std::uint16_t bitsPerSample,
+    const std::uint32_t dataSize) {
+
+    assert(header != nullptr);
+
+    const auto blockAlign { static_cast<std::uint16_t>(numChannels * (bitsPerSample / 8)) };
+
+    std::memcpy(header + 0, "RIFF", 4);
+    writeLittleEndian<std::uint32_t>(header, 4, static_cast<std::uint32_t>(WAV_HEADER_SIZE - 8 + dataSize));
+    std::memcpy(header + 8, "WAVE", 4);
+    std::memcpy(header + 12, "fmt ", 4);
+    writeLittleEndian<std::uint32_t>(header, 16, 16); // fmt chunk size
+    writeLittleEndian<std::uint16_t>(header, 20, 1); // WAVE_FORMAT_PCM
+    writeLittleEndian(header, 22, numChannels);
+    writeLittleEndian(header, 24, sampleRate);
+    writeLittleEndian<std::uint32_t>(header, 28, sampleRate * blockAlign);
+    writeLittleEndian(header, 32, blockAlign);
+    writeLittleEndian(header, 34, bitsPerSample);
+    std::memcpy(header + 36, "data", 4);
+    writeLittleEndian(header, 40, dataSize);
+}
+
+//converts signed 8 bit samples into the unsigned 8 bit samples WAV uses, in place.
+//this is just flipping the top bit of every byte.
+static void convertSigned8ToUnsigned(unsigned char *const samples, const std::size_t count) {
+    std::size_t i { 0 };
+#ifdef SM3TOOLS_SSE2
+    const __m128i signBits { _mm_set1_epi8(static_cast<char>(0x80)) };
+    for (; i + 16 <= count; i += 16) {
+        __m128i *const block { reinterpret_cast<__m128i *>(samples + i) };
+        _mm_storeu_si128(block, _mm_xor_si128(_mm_loadu_si128(block), signBits));
+    }
+#endif
+    for (; i < count; i++) {
+        samples[i] = static_cast<unsigned char>(samples[i] ^ 0x80);
+    }
+}
+
+//PCM data in FSBs is interleaved little-endian like in WAVs,
+//so 16 bit audio can be copied directly and 8 bit only needs its sign changing.
+static void writePCMData(
+    const AudioReader& read,
+    const AudioWriter& write,
+    const FSBHeader& header,
+    const std::uint32_t dataSize,
+    AudioAnalyser *const analyser) {
+
+    const bool needsSignConversion { (header.mode & FSBMode::BITS_8) != 0
+        && (header.mode & FSBMode::UNSIGNED) == 0 };
+
+    std::vector<unsigned char> buffer(CONVERT_BUFFER_SIZE);
+    std::size_t remaining { dataSize };
+    while (remaining > 0) {
+        const std::size_t readCount { std::min(remaining, buffer.size()) };
+        const std::size_t numRead { read(buffer.data(), readCount) };
+        if (numRead == 0) {
+            break;
+        }
+        //analysed before the sign is changed, while the samples are still in the FSB's format
+        if (analyser != nullptr) {
+            analyseChunk(*analyser, buffer.data(), numRead);
+        }
+        if (needsSignConversion) {
+            convertSigned8ToUnsigned(buffer.data(), numRead);
+        }
+        write(buffer.data(), numRead);
+        remaining -= numRead;
+    }
+}
+
+constexpr std::array<std::int16_t, 89> IMA_STEP_TABLE {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767 };
+
+constexpr std::array<int, 8> IMA_INDEX_TABLE { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+struct ImaChannelState {
+    int predictor {};
+    int stepIndex {};
+};
+
+static std::int16_t decodeImaNibble(ImaChannelState& state, const unsigned int nibble) {
+    const int step { IMA_STEP_TABLE[static_cast<std::size_t>(state.stepIndex)] };
+    int difference { step >> 3 };
+    if (nibble & 1) difference += step >> 2;
+    if (nibble & 2) difference += step >> 1;
+    if (nibble & 4) difference += step;
+    state.predictor += (nibble & 8) ? -difference : difference;
+    state.predictor = std::clamp(state.predictor, -32768, 32767);
+    state.stepIndex = std::clamp(state.stepIndex + IMA_INDEX_TABLE[nibble & 7], 0, 88);
+    return static_cast<std::int16_t>(state.predictor);
+}
+
+//decodes one interleaved IMA ADPCM block (IMA_ADPCM_BLOCK_SIZE bytes per channel) into
+//IMA_ADPCM_SAMPLES_PER_BLOCK interleaved little-endian 16 bit frames.
+//the block starts with a 4 byte header for each channel, then alternates
+//between 4 bytes (8 samples) of each channel.
+static void decodeImaBlock(
+    const unsigned char *const block,
+    const std::uint16_t numChannels,
+    unsigned char *const output) {
+
+    for (std::size_t channel = 0; channel < numChannels; channel++) {
+        const unsigned char *const channelHeader { block + channel * 4 };
+        ImaChannelState state {
+            static_cast<std::int16_t>(readLittleEndian<std::uint16_t>(channelHeader, 0)),
+            std::clamp(static_cast<int>(channelHeader[2]), 0, 88) };
+
+        const unsigned char *const data { block + numChannels * std::size_t { 4 } };
+        for (std::size_t group = 0; group < IMA_ADPCM_SAMPLES_PER_BLOCK / 8; group++) {
+            const unsigned char *const groupBytes { data + (group * numChannels + channel) * 4 };
+            for (std::size_t byte = 0; byte < 4; byte++) {
+                //the low nibble holds the earlier sample
+                for (unsigned int shift = 0; shift <= 4; shift += 4) {
+                    const std::size_t frame { group * 8 + byte * 2 + shift / 4 };
+                    const std::int16_t sample { decodeImaNibble(state, (groupBytes[byte] >> shift) & 0xFU) };
+                    writeLittleEndian(output, (frame * numChannels + channel) * 2,
+                        static_cast<std::uint16_t>(sample));
+                }
+            }
+        }
+    }
+}
+
+static void writeImaAdpcmData(
+    const AudioReader& read,
+    const AudioWriter& write,
+    const std::uint16_t numChannels,
+    const std::size_t blockCount) {
+
+    const std::size_t blockAlign { IMA_ADPCM_BLOCK_SIZE * numChannels };
+    const std::size_t decodedBlockSize { IMA_ADPCM_SAMPLES_PER_BLOCK * numChannels * 2 };
+    const std::size_t blocksPerChunk { std::max<std::size_t>(1, CONVERT_BUFFER_SIZE / blockAlign) };
+
+    std::vector<unsigned char> input(blocksPerChunk * blockAlign);
+    std::vector<unsigned char> output(blocksPerChunk * decodedBlockSize);
+
+    std::size_t remaining { blockCount };
+    while (remaining > 0) {
+        const std::size_t chunkBlocks { std::min(remaining, blocksPerChunk) };
+        const std::size_t numRead { read(input.data(), chunkBlocks * blockAlign) };
+        const std::size_t blocksRead { numRead / blockAlign };
+        for (std::size_t b = 0; b < blocksRead; b++) {
+            decodeImaBlock(input.data() + b * blockAlign, numChannels, output.data() + b * decodedBlockSize);
+        }
+        if (blocksRead == 0) {
+            break;
+        }
+        write(output.data(), blocksRead * decodedBlockSize);
+        remaining -= blocksRead;
+    }
+}
+
+//the shape of the WAV file that the audio of an FSB is converted into
+struct WavLayout {
+    std::uint16_t numChannels {};
+    std::uint16_t bitsPerSample {};
+    bool isAdpcm {};
+    std::uint32_t inputSize {}; // bytes of FSB audio data that are converted
+    std::uint32_t outputSize {}; // bytes of samples in the WAV, after the header
+    std::size_t blockCount {}; // number of ADPCM blocks per channel (0 for PCM)
+};
+
+//availableSize is how many bytes of audio data there really are, which is less than
+//header.dataSize if the FSB was cut short. the WAV only claims the audio that is there
+static WavLayout wavLayout(const FSBHeader& header, const std::size_t availableSize) {
+    const auto dataSize { static_cast<std::uint32_t>(std::min<std::size_t>(header.dataSize, availableSize)) };
+
+    WavLayout layout {};
+    layout.numChannels = channelCount(header);
+    layout.isAdpcm = (header.mode & FSBMode::IMAADPCM) != 0;
+    layout.bitsPerSample = (!layout.isAdpcm && (header.mode & FSBMode::BITS_8)) ? std::uint16_t { 8 } : std::uint16_t { 16 };
+
+    //trailing bytes that don't make up a whole frame (or ADPCM block) are left out
+    if (layout.isAdpcm) {
+        layout.blockCount = dataSize / (IMA_ADPCM_BLOCK_SIZE * layout.numChannels);
+        layout.inputSize = static_cast<std::uint32_t>(layout.blockCount * IMA_ADPCM_BLOCK_SIZE * layout.numChannels);
+        layout.outputSize = static_cast<std::uint32_t>(layout.blockCount * IMA_ADPCM_SAMPLES_PER_BLOCK * layout.numChannels * 2);
+    }
+    else {
+        const std::uint32_t frameSize { layout.numChannels * layout.bitsPerSample / 8U };
+        layout.inputSize = dataSize - (dataSize % frameSize);
+        layout.outputSize = layout.inputSize;
+    }
+    return layout;
+}
+
+//gives the WAV header and converted audio of an FSB with the given header
+//to write, taking the availableSize bytes of FSB audio data from read
+static void convertWav(
+    const FSBHeader& header,
+    const std::size_t availableSize,
+    const AudioReader& read,
+    const AudioWriter& write,
+    AudioAnalysis *const analysis) {
+
+    const WavLayout layout { wavLayout(header, availableSize) };
+
+    std::array<unsigned char, WAV_HEADER_SIZE> wavHeader {};
+    buildWavHeader(wavHeader.data(), layout.numChannels, header.frequency, layout.bitsPerSample, layout.outputSize);
+
+    //only PCM is analysed, so ADPCM gets an empty analysis
+    AudioAnalyser analyser { startAnalysis(header) };
+
+    write(wavHeader.data(), wavHeader.size());
+    if (layout.isAdpcm) {
+        writeImaAdpcmData(read, write, layout.numChannels, layout.blockCount);
+    }
+    else {
+        writePCMData(read, write, header, layout.inputSize, analysis != nullptr ? &analyser : nullptr);
+    }
+
+    if (analysis != nullptr) {
+        *analysis = finishAnalysis(analyser);
+    }
+}
+
+//writes the WAV header and converted audio of an FSB with the given header
+//into outputFileName, taking the availableSize bytes of FSB audio data from read
+static void writeWav(
+    const FSBHeader& header,
+    const std::size_t availableSize,
+    const AudioReader& read,
+    const std::string& outputFileName,
+    AudioAnalysis *const analysis) {
+
+    std::FILE *const outputFileHandle { MyIO::fopen(outputFileName.c_str(), "wb") };
+    {
+        convertWav(header, availableSize, read, [outputFileHandle](const unsigned char *const data, const std::size_t count) {
+            (void) MyIO::fwrite(data, sizeof(char), count, outputFileHandle);
+        }, analysis);
+    }
+    (void) std::fclose(outputFileHandle);
+}
+
+//returns a reader that copies from the dataSize bytes at data
+static AudioReader memoryReader(const unsigned char *const data, const std::size_t dataSize) {
+    return [data, dataSize, position = std::size_t { 0 }](unsigned char *const buffer, const std::size_t count) mutable {
+        const std::size_t copyCount { std::min(count, dataSize - position) };
+        if (copyCount > 0) {
+            std::memcpy(buffer, data + position, copyCount);
+        }
+        position += copyCount;
+        return copyCount;
+    };
+}
+
+void convertWavFile(
+    const FSBHeader& header,
+    std::FILE *const inputFileHandle,
+    const std::size_t availableSize,
+    const AudioWriter& write,
+    AudioAnalysis *const analysis) {
+
+    assert(inputFileHandle != nullptr);
+    assert(isWavConvertible(header));
+
+    convertWav(header, availableSize, [inputFileHandle](unsigned char *const buffer, const std::size_t count) {
+        return MyIO::fread(buffer, sizeof(char), count, inputFileHandle);
+    }, write, analysis);
+}
+
+void writeWavData(
+    const FSBHeader& header,
+    const unsigned char *const data,
+    const std::size_t dataSize,
+    const std::string& outputFileName,
+    AudioAnalysis *const analysis) {
+
+    assert(data != nullptr || dataSize == 0);
+    assert(!outputFileName.empty());
+    assert(isWavConvertible(header));
+
+    writeWav(header, dataSize, memoryReader(data, dataSize), outputFileName, analysis);
+}
+
+void convertWavData(
+    const FSBHeader& header,
+    const unsigned char *const data,
+    const std::size_t dataSize,
+    std::vector<unsigned char>& wavFile,
+    AudioAnalysis *const analysis) {
+
+    assert(data != nullptr || dataSize == 0);
+    assert(isWavConvertible(header));
+
+    wavFile.clear();
+    wavFile.reserve(WAV_HEADER_SIZE + wavLayout(header, dataSize).outputSize);
+    convertWav(header, dataSize, memoryReader(data, dataSize), [&wavFile](const unsigned char *const chunk, const std::size_t count) {
+        wavFile.insert(wavFile.end(), chunk, chunk + count);
+    }, analysis);
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2025 SpiderGlider
+ *
+ * This file is part of sm3tools.
+ *
+ * sm3tools is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * sm3tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with sm3tools. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAV_H
+#define WAV_H
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include "pcssb.hpp"
+
+struct AudioAnalysis;
+
+//size of a canonical RIFF WAVE header with a PCM fmt chunk, up to the start of the samples
+constexpr std::size_t WAV_HEADER_SIZE { 44 };
+
+//size in bytes of one IMA ADPCM block for one channel, as used by FSBs.
+//the first 4 bytes are the block header and each of the
+//remaining 32 bytes holds two samples
+constexpr std::size_t IMA_ADPCM_BLOCK_SIZE { 36 };
+constexpr std::size_t IMA_ADPCM_SAMPLES_PER_BLOCK { 64 };
+
+//number of interleaved channels in the audio of an FSB with this header.
+//falls back to the mode flags if the channel count field is 0.
+std::uint16_t channelCount(const FSBHeader& header);
+
+//whether the audio of an FSB with this header is uncompressed 8 or 16 bit PCM.
+bool isPCM(const FSBHeader& header);
+
+//whether the audio data of an FSB with this header can be converted into a WAV file
+//(by convertWavFile, writeWavData or convertWavData).
+//this is the case for 8 and 16 bit PCM, and IMA ADPCM.
+bool isWavConvertible(const FSBHeader& header);
+
+//fills the first WAV_HEADER_SIZE bytes of header with a RIFF WAVE header
+//for 16 bit (or 8 bit if bitsPerSample is 8) PCM audio.
+void buildWavHeader(
+    unsigned char *header,
+    std::uint16_t numChannels,
+    std::uint32_t sampleRate,
+    std::uint16_t bitsPerSample,
+    std::uint32_t dataSize);
+
+//takes count bytes of the WAV file being made from data
+using AudioWriter = std::function<void(const unsigned char *data, std::size_t count)>;
+
+//converts the availableSize bytes of FSB audio data at the current position of inputFileHandle
+//into a PCM WAV file, which is given to write a piece at a time as it is made. availableSize can
+//be less than header.dataSize if the FSB was cut short, in which case the sizes in the WAV header
+//only count the audio that is there.
+//The audio is streamed through a fixed size buffer rather than being read in all at once.
+//isWavConvertible(header) must be true.
+//If analysis isn't null, the audio is also analysed (see analysis.hpp) as it is converted
+//and the result is stored in it.
+void convertWavFile(
+    const FSBHeader& header,
+    std::FILE *inputFileHandle,
+    std::size_t availableSize,
+    const AudioWriter& write,
+    AudioAnalysis *analysis = nullptr);
+
+//same as convertWavFile, but converts the dataSize bytes of audio data at data, which are
+//already in memory, and writes the WAV file to outputFileName (overwriting it if it exists).
+void writeWavData(
+    const FSBHeader& header,
+    const unsigned char *data,
+    std::size_t dataSize,
+    const std::string& outputFileName,
+    AudioAnalysis *analysis = nullptr);
+
+//same as writeWavData, but puts the whole WAV file into wavFile (replacing what was in it)
+//instead of writing it, so it can be used without a file (e.g. to fingerprint it).
+void convertWavData(
+    const FSBHeader& header,
+    const unsigned char *data,
+    std::size_t dataSize,
+    std::vector<unsigned char>& wavFile,
+    AudioAnalysis *analysis = nullptr);
+
+#endif